@@ -0,0 +1,212 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "androiddependencyextractor.h"
+#include "batchreadobjdependencyextractor.h"
+#include "cachingdependencyextractor.h"
+#include "corpusgenerator.h"
+#include "elfdependencyextractor.h"
+#include "parallel.h"
+
+#include <CLI/CLI.hpp>
+
+namespace {
+std::atomic<size_t> allocationCount = 0;
+std::atomic<size_t> allocatedBytes = 0;
+
+struct PhaseResult
+{
+    std::string name;
+    double seconds = 0;
+    size_t libraries = 0;
+    size_t peakRss = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+size_t peakRssKiB()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.starts_with("VmHWM:"))
+            return std::strtoull(line.c_str() + 6, nullptr, 10);
+    return 0;
+}
+
+void resetPeakRss()
+{
+    // Linux resets VmHWM to current RSS on "5"
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+// Runs phase, function returns number of processed libraries
+PhaseResult measure(const std::string& name, const std::function<size_t()>& function)
+{
+    resetPeakRss();
+    auto allocations = allocationCount.load();
+    auto bytes = allocatedBytes.load();
+    auto start = std::chrono::steady_clock::now();
+    auto libraries = function();
+    auto end = std::chrono::steady_clock::now();
+    return {.name = name,
+            .seconds = std::chrono::duration<double>(end - start).count(),
+            .libraries = libraries,
+            .peakRss = peakRssKiB(),
+            .allocations = allocationCount - allocations,
+            .bytes = allocatedBytes - bytes};
+}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    ++allocationCount;
+    allocatedBytes += size;
+    if (auto pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+int main(int argc, char* argv[])
+{
+    const std::map<std::string, size_t> SCALES{
+        {"small", 200}, {"medium", 2000}, {"large", 10000}, {"huge", 50000}};
+
+    CLI::App app{"Dependency scanner benchmark on synthetic ELF corpus"};
+    std::string scale = "small";
+    std::string directory;
+    std::string backend = "elf";
+    std::string readobj = "llvm-readobj";
+    unsigned jobs = Parallel::defaultJobs();
+    bool keep = false;
+    bool elf32 = false;
+    bool bigEndian = false;
+    CorpusOptions corpusOptions;
+    app.add_option("-s,--scale", scale, "Corpus size: small, medium, large or huge")
+        ->check(CLI::IsMember({"small", "medium", "large", "huge"}));
+    app.add_option("--libraries", corpusOptions.libraries, "Number of libraries (overrides scale)");
+    app.add_option("--fan-out", corpusOptions.fanOut, "Dependencies per library");
+    app.add_option("--depth", corpusOptions.depth, "Dependency levels");
+    app.add_option("--cycles", corpusOptions.cycles, "Number of dependency cycles");
+    app.add_option("--missing", corpusOptions.missing, "Number of missing dependencies");
+    app.add_option("--filler", corpusOptions.fillerFiles, "Unrelated libraries in every directory");
+    app.add_option("--padding", corpusOptions.image.padding, "Extra bytes in every library");
+    app.add_option("--seed", corpusOptions.seed, "Random seed");
+    app.add_flag("--elf32", elf32, "Generate ELF32 instead of ELF64");
+    app.add_flag("--big-endian", bigEndian, "Generate big endian libraries");
+    app.add_option("-o,--output", directory, "Corpus directory (temporary by default)");
+    app.add_flag("-k,--keep", keep, "Keep generated corpus");
+    app.add_option("-b,--backend", backend, "Library scanner: elf, readobj or readobj-batch")
+        ->check(CLI::IsMember({"elf", "readobj", "readobj-batch"}));
+    app.add_option("--readobj", readobj, "llvm-readobj used by readobj backends");
+    app.add_option("--jobs", jobs, "Workers in parallel phases")->check(CLI::PositiveNumber);
+    CLI11_PARSE(app, argc, argv);
+
+    if (app.count("--libraries") == 0)
+        corpusOptions.libraries = SCALES.at(scale);
+    corpusOptions.image.elf64 = !elf32;
+    corpusOptions.image.bigEndian = bigEndian;
+    if (directory.empty())
+        directory = fmt::format("{}/dependencyscanner-bench-{}", std::filesystem::temp_directory_path().string(),
+                                corpusOptions.libraries);
+    std::filesystem::remove_all(directory);
+    spdlog::set_level(spdlog::level::warn);
+
+    auto createExtractor = [&]() -> std::unique_ptr<DependencyExtractor> {
+        if (backend == "readobj")
+            return std::make_unique<AndroidDependencyExtractor>(readobj);
+        if (backend == "readobj-batch")
+            return std::make_unique<BatchReadobjDependencyExtractor>(readobj);
+        return std::make_unique<ElfDependencyExtractor>();
+    };
+
+    std::vector<PhaseResult> phases;
+    Corpus corpus;
+    phases.push_back(measure("generate", [&]() {
+        corpus = generateCorpus(directory, corpusOptions);
+        return corpus.libraries;
+    }));
+
+    ExtractorOptions options{.libraryDirs = {corpus.appDir}, .scanDirs = {corpus.qtDir}, .systemDirs = {corpus.systemDir}};
+    phases.push_back(measure("preloadInfo", [&]() {
+        options.preloadInfo(".so");
+        return options.libraries.size();
+    }));
+
+    std::vector<std::string> summaries;
+    auto resolvePhase = [&](const std::string& name, DependencyExtractor& extractor, unsigned phaseJobs) {
+        phases.push_back(measure(name, [&]() {
+            options.jobs = phaseJobs;
+            SharedLibrary root{.name = corpus.appName, .path = corpus.appPath};
+            auto result = extractor.resolveDependencies(root, options);
+            summaries.push_back(fmt::format("{}: {} resolved, {} to copy, {} unmet", name, result.resolved.size(),
+                                            result.availableForCopy.size(), result.unmet.size()));
+            size_t scanned = 0;
+            for (const auto& lib : result.resolved)
+                scanned += lib.scanned();
+            return scanned;
+        }));
+    };
+
+    auto extractor = createExtractor();
+    resolvePhase("resolve (1 job)", *extractor, 1);
+    resolvePhase(fmt::format("resolve ({} jobs)", jobs), *extractor, jobs);
+
+    auto cachePath = fmt::format("{}/scan.cache", directory);
+    {
+        ScanCache cache(cachePath);
+        cache.load();
+        CachingDependencyExtractor cached(createExtractor(), cache);
+        resolvePhase("resolve (cold cache)", cached, jobs);
+        phases.push_back(measure("save cache", [&]() {
+            cache.save();
+            return cache.misses();
+        }));
+    }
+    {
+        ScanCache cache(cachePath);
+        phases.push_back(measure("load cache", [&]() {
+            cache.load();
+            return size_t(0);
+        }));
+        CachingDependencyExtractor cached(createExtractor(), cache);
+        resolvePhase("resolve (warm cache)", cached, jobs);
+    }
+
+    fmt::print("Corpus: {} libraries, {:.1f} MiB, backend {}\n", corpus.libraries, corpus.bytes / 1048576.0, backend);
+    fmt::print("{:<24} {:>10} {:>12} {:>12} {:>12} {:>12}\n", "phase", "time [ms]", "libs/s", "peak RSS MiB",
+               "allocations", "alloc MiB");
+    for (const auto& phase : phases)
+        fmt::print("{:<24} {:>10.2f} {:>12.0f} {:>12.1f} {:>12} {:>12.2f}\n", phase.name, phase.seconds * 1000,
+                   phase.seconds > 0 ? phase.libraries / phase.seconds : 0.0, phase.peakRss / 1024.0,
+                   phase.allocations, phase.bytes / 1048576.0);
+    for (const auto& summary : summaries)
+        fmt::print("{}\n", summary);
+
+    if (!keep)
+        std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "corpusgenerator.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+
+namespace {
+class ImageWriter
+{
+public:
+    ImageWriter(std::vector<char>& image, bool bigEndian) : image(image), bigEndian(bigEndian) {}
+
+    void put(size_t offset, uint64_t value, size_t size)
+    {
+        if (image.size() < offset + size)
+            image.resize(offset + size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            auto shift = 8 * (bigEndian ? size - 1 - i : i);
+            image[offset + i] = static_cast<char>((value >> shift) & 0xff);
+        }
+    }
+
+private:
+    std::vector<char>& image;
+    bool bigEndian;
+};
+
+void writeFile(const std::string& path, const std::vector<char>& content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+} // namespace
+
+std::vector<char> makeSharedObject(const std::string& soname, const std::vector<std::string>& needed,
+                                   const ElfImageOptions& options)
+{
+    constexpr uint64_t DT_NEEDED = 1;
+    constexpr uint64_t DT_STRTAB = 5;
+    constexpr uint64_t DT_STRSZ = 10;
+    constexpr uint64_t DT_SONAME = 14;
+
+    const size_t word = options.elf64 ? 8 : 4;
+    const size_t headerSize = options.elf64 ? 64 : 52;
+    const size_t programHeaderSize = options.elf64 ? 56 : 32;
+    const size_t stringsOffset = headerSize + 2 * programHeaderSize;
+
+    std::string strings(1, '\0');
+    std::vector<std::pair<uint64_t, uint64_t>> dynamic;
+    for (const auto& name : needed)
+    {
+        dynamic.emplace_back(DT_NEEDED, strings.size());
+        strings.append(name).push_back('\0');
+    }
+    dynamic.emplace_back(DT_SONAME, strings.size());
+    strings.append(soname).push_back('\0');
+    dynamic.emplace_back(DT_STRTAB, stringsOffset);
+    dynamic.emplace_back(DT_STRSZ, strings.size());
+    dynamic.emplace_back(0, 0);
+
+    const size_t dynamicOffset = (stringsOffset + strings.size() + word - 1) / word * word;
+    const size_t dynamicSize = dynamic.size() * 2 * word;
+    const size_t fileSize = dynamicOffset + dynamicSize + options.padding;
+
+    std::vector<char> image(fileSize, 0);
+    ImageWriter writer(image, options.bigEndian);
+    image[0] = 0x7f;
+    image[1] = 'E';
+    image[2] = 'L';
+    image[3] = 'F';
+    image[4] = options.elf64 ? 2 : 1;
+    image[5] = options.bigEndian ? 2 : 1;
+    image[6] = 1; // EV_CURRENT
+    writer.put(16, 3, 2); // ET_DYN
+    writer.put(18, options.machine, 2);
+    writer.put(20, 1, 4);
+    if (options.elf64)
+    {
+        writer.put(32, headerSize, 8); // e_phoff
+        writer.put(52, headerSize, 2);
+        writer.put(54, programHeaderSize, 2);
+        writer.put(56, 2, 2);
+        writer.put(58, 64, 2);
+    }
+    else
+    {
+        writer.put(28, headerSize, 4);
+        writer.put(40, headerSize, 2);
+        writer.put(42, programHeaderSize, 2);
+        writer.put(44, 2, 2);
+        writer.put(46, 40, 2);
+    }
+
+    auto putSegment = [&](size_t entry, uint32_t type, uint32_t flags, uint64_t offset, uint64_t size) {
+        writer.put(entry, type, 4);
+        if (options.elf64)
+        {
+            writer.put(entry + 4, flags, 4);
+            writer.put(entry + 8, offset, 8);
+            writer.put(entry + 16, offset, 8);
+            writer.put(entry + 24, offset, 8);
+            writer.put(entry + 32, size, 8);
+            writer.put(entry + 40, size, 8);
+            writer.put(entry + 48, word, 8);
+        }
+        else
+        {
+            writer.put(entry + 4, offset, 4);
+            writer.put(entry + 8, offset, 4);
+            writer.put(entry + 12, offset, 4);
+            writer.put(entry + 16, size, 4);
+            writer.put(entry + 20, size, 4);
+            writer.put(entry + 24, flags, 4);
+            writer.put(entry + 28, word, 4);
+        }
+    };
+    putSegment(headerSize, 1, 6, 0, fileSize);                                  // PT_LOAD, RW
+    putSegment(headerSize + programHeaderSize, 2, 6, dynamicOffset, dynamicSize); // PT_DYNAMIC
+
+    std::copy(strings.begin(), strings.end(), image.begin() + static_cast<std::ptrdiff_t>(stringsOffset));
+    for (size_t index = 0; index < dynamic.size(); ++index)
+    {
+        writer.put(dynamicOffset + 2 * word * index, dynamic[index].first, word);
+        writer.put(dynamicOffset + 2 * word * index + word, dynamic[index].second, word);
+    }
+    return image;
+}
+
+Corpus generateCorpus(const std::string& directory, const CorpusOptions& options)
+{
+    Corpus corpus{.appDir = fmt::format("{}/app", directory),
+                  .qtDir = fmt::format("{}/qt", directory),
+                  .systemDir = fmt::format("{}/system", directory),
+                  .appName = "bench"};
+    corpus.appPath = fmt::format("{}/lib{}.so", corpus.appDir, corpus.appName);
+    for (const auto& dir : {corpus.appDir, corpus.qtDir, corpus.systemDir})
+        std::filesystem::create_directories(dir);
+
+    std::mt19937 random(options.seed);
+    auto pick = [&random](size_t count) { return std::uniform_int_distribution<size_t>(0, count - 1)(random); };
+
+    // Libraries are spread over levels, every library gets one parent on the
+    // level above so all of them are reachable from the application
+    auto depth = std::max<size_t>(1, std::min(options.depth, options.libraries));
+    std::vector<std::vector<size_t>> levels(depth);
+    std::vector<size_t> levelOf(options.libraries);
+    for (size_t index = 0; index < options.libraries; ++index)
+    {
+        levelOf[index] = index < depth ? index : pick(depth);
+        levels[levelOf[index]].push_back(index);
+    }
+
+    std::vector<std::vector<std::string>> needed(options.libraries);
+    std::vector<std::string> names(options.libraries);
+    std::vector<std::string> appNeeded;
+    for (size_t index = 0; index < options.libraries; ++index)
+        names[index] = fmt::format("libbench{}.so", index);
+
+    for (auto index : levels[0])
+        appNeeded.push_back(names[index]);
+    for (size_t level = 1; level < depth; ++level)
+        for (auto index : levels[level])
+        {
+            const auto& parents = levels[level - 1];
+            needed[parents[pick(parents.size())]].push_back(names[index]);
+        }
+    for (size_t level = 0; level + 1 < depth; ++level)
+        for (auto index : levels[level])
+            while (needed[index].size() < options.fanOut)
+            {
+                const auto& children = levels[level + 1 + pick(depth - level - 1)];
+                needed[index].push_back(names[children[pick(children.size())]]);
+            }
+    for (size_t cycle = 0; cycle < options.cycles && depth > 1; ++cycle)
+    {
+        auto lower = 1 + pick(depth - 1);
+        auto upper = pick(lower);
+        const auto& from = levels[lower];
+        const auto& to = levels[upper];
+        needed[from[pick(from.size())]].push_back(names[to[pick(to.size())]]);
+    }
+    for (size_t index = 0; index < options.missing; ++index)
+        needed[pick(options.libraries)].push_back(fmt::format("libmissing{}.so", index));
+
+    auto write = [&](const std::string& dir, const std::string& name, std::vector<std::string> dependencies) {
+        std::sort(dependencies.begin(), dependencies.end());
+        dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+        auto image = makeSharedObject(name, dependencies, options.image);
+        corpus.bytes += image.size();
+        writeFile(fmt::format("{}/{}", dir, name), image);
+    };
+
+    write(corpus.appDir, fmt::format("lib{}.so", corpus.appName), appNeeded);
+    for (size_t index = 0; index < options.libraries; ++index)
+    {
+        // Deepest level acts as platform, the rest is split between app and Qt
+        const auto& dir = levelOf[index] + 1 == depth && depth > 1 ? corpus.systemDir
+                          : index % 2 == 0                         ? corpus.appDir
+                                                                   : corpus.qtDir;
+        write(dir, names[index], needed[index]);
+    }
+    for (const auto& dir : {corpus.appDir, corpus.qtDir, corpus.systemDir})
+        for (size_t index = 0; index < options.fillerFiles; ++index)
+            write(dir, fmt::format("libfiller{}.so", index), {});
+
+    corpus.libraries = options.libraries + 1;
+    return corpus;
+}
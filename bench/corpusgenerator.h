@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ElfImageOptions
+{
+    bool elf64 = true;
+    bool bigEndian = false;
+    uint16_t machine = 183; // EM_AARCH64
+    size_t padding = 0;     // extra bytes appended to reach realistic file sizes
+};
+
+// Smallest shared object that dynamic linkers and readers accept: ELF header,
+// PT_LOAD covering the whole file, PT_DYNAMIC with DT_NEEDED/DT_SONAME entries
+std::vector<char> makeSharedObject(const std::string& soname, const std::vector<std::string>& needed,
+                                   const ElfImageOptions& options = {});
+
+struct CorpusOptions
+{
+    size_t libraries = 200;
+    size_t fanOut = 4;      // dependencies per library
+    size_t depth = 6;       // levels below the application
+    size_t cycles = 0;      // back edges to shallower levels
+    size_t missing = 0;     // dependencies that are not present anywhere
+    size_t fillerFiles = 0; // unrelated libraries in every directory
+    uint32_t seed = 1;
+    ElfImageOptions image;
+};
+
+struct Corpus
+{
+    std::string appDir;    // libraryDirs tier
+    std::string qtDir;     // scanDirs tier
+    std::string systemDir; // systemDirs tier
+    std::string appName;
+    std::string appPath;
+    size_t libraries = 0;
+    size_t bytes = 0;
+};
+
+Corpus generateCorpus(const std::string& directory, const CorpusOptions& options);
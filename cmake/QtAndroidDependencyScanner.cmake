@@ -0,0 +1,78 @@
+# Runs qtandroiddependencyscanner as a build step that is up to date as long as
+# nothing it read last time (libraries, library directories, plugin metadata,
+# JSON config) changed, so no-op builds skip the scan.
+#
+#   qt_android_dependency_scan(<name>
+#       DIRECTORY <android-build/libs>
+#       [JSON <android_deployment_settings.json>]
+#       [PLATFORM <api level>] [NDK <ndk>] [QT <qt>]
+#       [DEPLOY <directory>] [FIX] [PLUGINS] [STRIP]
+#       [SCANNER <path>]
+#       [DEPENDS <targets or files>...]
+#       [ARGS <other scanner options>...])
+#
+# Adds target <name> built with ALL. Scanner is the qtandroiddependencyscanner
+# target when it is part of the build, otherwise it is searched for in PATH.
+# Stamp file <name>.stamp in current binary directory lists deployed libraries.
+function(qt_android_dependency_scan name)
+  cmake_parse_arguments(PARSE_ARGV 1 ARG "FIX;PLUGINS;STRIP" "DIRECTORY;JSON;PLATFORM;NDK;QT;DEPLOY;SCANNER"
+                        "DEPENDS;ARGS")
+  if(NOT ARG_DIRECTORY)
+    message(FATAL_ERROR "qt_android_dependency_scan: DIRECTORY is required")
+  endif()
+  if(CMAKE_VERSION VERSION_LESS 3.20 AND NOT CMAKE_GENERATOR MATCHES "Ninja")
+    message(FATAL_ERROR "qt_android_dependency_scan: depfiles need Ninja or CMake 3.20")
+  endif()
+
+  if(ARG_SCANNER)
+    set(scanner ${ARG_SCANNER})
+  elseif(TARGET qtandroiddependencyscanner)
+    set(scanner $<TARGET_FILE:qtandroiddependencyscanner>)
+    list(APPEND ARG_DEPENDS qtandroiddependencyscanner)
+  else()
+    find_program(QT_ANDROID_DEPENDENCY_SCANNER qtandroiddependencyscanner)
+    if(NOT QT_ANDROID_DEPENDENCY_SCANNER)
+      message(FATAL_ERROR "qt_android_dependency_scan: qtandroiddependencyscanner not found")
+    endif()
+    set(scanner ${QT_ANDROID_DEPENDENCY_SCANNER})
+  endif()
+
+  set(stamp ${CMAKE_CURRENT_BINARY_DIR}/${name}.stamp)
+  set(depfile ${CMAKE_CURRENT_BINARY_DIR}/${name}.d)
+  set(command ${scanner} --directory ${ARG_DIRECTORY} --stamp ${stamp} --depfile ${depfile}
+              --cache ${CMAKE_CURRENT_BINARY_DIR}/${name}.cache)
+  if(ARG_JSON)
+    list(APPEND command --json ${ARG_JSON})
+    list(APPEND ARG_DEPENDS ${ARG_JSON})
+  endif()
+  if(ARG_PLATFORM)
+    list(APPEND command --platform ${ARG_PLATFORM})
+  endif()
+  if(ARG_NDK)
+    list(APPEND command --ndk ${ARG_NDK})
+  endif()
+  if(ARG_QT)
+    list(APPEND command --qt ${ARG_QT})
+  endif()
+  if(ARG_DEPLOY)
+    list(APPEND command --deploy ${ARG_DEPLOY})
+  endif()
+  if(ARG_FIX)
+    list(APPEND command --fix)
+  endif()
+  if(ARG_PLUGINS)
+    list(APPEND command --plugins)
+  endif()
+  if(ARG_STRIP)
+    list(APPEND command --deploy-strip)
+  endif()
+
+  add_custom_command(
+    OUTPUT ${stamp}
+    COMMAND ${command} ${ARG_ARGS}
+    DEPENDS ${ARG_DEPENDS}
+    DEPFILE ${depfile}
+    COMMENT "Checking Android dependencies (${name})"
+    VERBATIM)
+  add_custom_target(${name} ALL DEPENDS ${stamp})
+endfunction()
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "dependencyextractor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "dependency_extractor_export.h"
+
+// Lets architectures reuse scan results of a reference architecture. Builds of
+// one app have the same DT_NEEDED names on every architecture up to the ABI
+// suffix (libQt5Core_x86.so). Results of reference architecture are recorded
+// with that suffix replaced by ${ANDROID_ABI}. For other architectures needed
+// libraries are read from the dynamic section in process and only their hash
+// is compared with the reference: matching libraries take the reference result
+// and only those that differ are passed to the backend. Reading the dynamic
+// section is what ELF backend does anyway, so this pays off with readobj
+// backends, which start a process per library (or per batch).
+class DEPENDENCY_EXTRACTOR_EXPORT AbiReuseDependencyExtractor : public DependencyExtractor
+{
+public:
+    // Scan results of reference architecture, shared by all architectures
+    class DEPENDENCY_EXTRACTOR_EXPORT Reference
+    {
+    public:
+        void store(const SharedLibrary& library, const std::string& abi);
+        // Result recorded for library with the same file name (up to ABI) and needed hash, mapped to abi
+        bool find(SharedLibrary& library, const std::string& abi, uint64_t neededHash) const;
+
+    private:
+        struct Entry
+        {
+            uint64_t neededHash;
+            SharedLibrary library;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry> libraries;
+    };
+
+    // Reference architecture (record) stores results of backend, others reuse them
+    AbiReuseDependencyExtractor(std::unique_ptr<DependencyExtractor> backend, Reference& reference, std::string abi,
+                                bool record);
+
+    void scanDependencies(SharedLibrary& target) override;
+    void scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs, const ScanCallback& onScanned) override;
+
+    size_t reusedCount() const { return reused; }
+    size_t differentCount() const { return different; }
+
+    // libQt5Core_x86.so -> libQt5Core_${ANDROID_ABI}.so for abi x86, other names are unchanged
+    static std::string neutralName(std::string_view name, std::string_view abi);
+    static std::string abiName(std::string_view name, std::string_view abi);
+    // Order independent hash of soname and needed names in neutral form
+    static uint64_t neededHash(const SharedLibrary& library, std::string_view abi);
+
+private:
+    bool reuse(SharedLibrary& target);
+
+    std::unique_ptr<DependencyExtractor> backend;
+    Reference& reference;
+    std::string abi;
+    bool record;
+    std::atomic<size_t> reused = 0;
+    std::atomic<size_t> different = 0;
+};
@@ -4,18 +4,19 @@
 
 #include "dependency_extractor_export.h"
 
+// Scans libraries with llvm-readobj from the NDK toolchain
 class DEPENDENCY_EXTRACTOR_EXPORT AndroidDependencyExtractor : public DependencyExtractor
 {
 public:
     AndroidDependencyExtractor(const std::string& tool);
 
     void scanDependencies(SharedLibrary& target) override;
-    ResolveResult resolveDependencies(SharedLibrary& target, const ExtractorOptions& options) override;
 
     static std::string getToolPath(const std::string& ndkPath, const std::string& toolchainPrefix,
                                    const std::string& ndkHost);
     static std::string platformPath(const std::string& ndkPath, const std::string& toolchainPrefix,
                                     const std::string& ndkHost, const std::string& arch, int platform);
+    static const std::set<std::string>& platformLibraries();
 
 private:
     std::string toolPath;
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+namespace spdlog {
+class logger;
+}
+
+using Architectures = std::vector<std::pair<std::string, std::string>>;
+
+// Runs the same task for every architecture at once. Each task gets its own
+// logger, output is held back and printed in architecture order when all
+// tasks are finished, so reports do not interleave.
+class DEPENDENCY_EXTRACTOR_EXPORT ArchitectureRunner
+{
+public:
+    using Task = std::function<bool(const std::string& abi, const std::string& triple, spdlog::logger& log)>;
+
+    explicit ArchitectureRunner(Architectures architectures);
+
+    // Returns true only if task succeeded for all architectures. Task of first
+    // architecture (if given) finishes before the others start, so they can reuse its results.
+    bool run(const Task& task, const std::string& first = {}) const;
+
+    const Architectures& architectures() const { return archs; }
+
+private:
+    Architectures archs;
+};
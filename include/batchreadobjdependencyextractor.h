@@ -0,0 +1,23 @@
+#pragma once
+
+#include "dependencyextractor.h"
+
+#include <string>
+
+#include "dependency_extractor_export.h"
+
+// llvm-readobj backend that passes many libraries to every process and keeps
+// a bounded pool of processes running. Output is read through non-blocking
+// pipes and every library is reported as soon as its section is complete.
+class DEPENDENCY_EXTRACTOR_EXPORT BatchReadobjDependencyExtractor : public DependencyExtractor
+{
+public:
+    explicit BatchReadobjDependencyExtractor(const std::string& tool, size_t batchSize = 32);
+
+    void scanDependencies(SharedLibrary& target) override;
+    void scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs, const ScanCallback& onScanned) override;
+
+private:
+    std::string toolPath;
+    size_t batchSize;
+};
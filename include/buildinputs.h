@@ -0,0 +1,32 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "dependency_extractor_export.h"
+
+// Files and directories a check read and files it deployed. Inputs are written
+// as Make/Ninja depfile of stamp file, so build systems run the check again
+// only when one of them changes (directories change when libraries are added
+// or removed). Stamp lists deployed files, one per line. Paths can be added by
+// several threads.
+class DEPENDENCY_EXTRACTOR_EXPORT BuildInputs
+{
+public:
+    // Entries of archives (<archive>!/<entry>) are recorded as archive
+    void addInput(std::string_view path);
+    void addOutput(std::string_view path);
+
+    // Writes stamp and depfile with stamp as target, inputs that do not exist are left out
+    bool write(const std::string& stampPath, const std::string& depfilePath) const;
+
+    // Path escaped for depfile (spaces, '#' and '$')
+    static std::string escape(std::string_view path);
+
+private:
+    mutable std::mutex mutex;
+    std::set<std::string> inputs;
+    std::set<std::string> outputs;
+};
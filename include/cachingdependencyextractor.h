@@ -0,0 +1,22 @@
+#pragma once
+
+#include "dependencyextractor.h"
+#include "scancache.h"
+
+#include <memory>
+
+#include "dependency_extractor_export.h"
+
+// Serves scan results from ScanCache and passes only misses to the wrapped backend
+class DEPENDENCY_EXTRACTOR_EXPORT CachingDependencyExtractor : public DependencyExtractor
+{
+public:
+    CachingDependencyExtractor(std::unique_ptr<DependencyExtractor> backend, ScanCache& cache);
+
+    void scanDependencies(SharedLibrary& target) override;
+    void scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs, const ScanCallback& onScanned) override;
+
+private:
+    std::unique_ptr<DependencyExtractor> backend;
+    ScanCache& cache;
+};
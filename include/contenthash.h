@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// Fast non-cryptographic hash of file content, a word at a time
+inline uint64_t contentHash(std::span<const std::byte> bytes)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ bytes.size();
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= bytes.size(); offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + offset, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    for (; offset < bytes.size(); ++offset)
+        hash = (hash ^ static_cast<uint64_t>(bytes[offset])) * 0x100000001b3ull;
+    return hash;
+}
@@ -10,6 +10,7 @@ struct SharedLibrary
 {
     std::string name;
     std::string path;
+    std::string soname;
     Dependencies dependencies;
     bool scanned = false;
 };
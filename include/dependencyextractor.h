@@ -1,10 +1,15 @@
 #pragma once
 
 #include "dependency.h"
+#include "dependencygraph.h"
+#include "directoryindex.h"
 
+#include <functional>
+#include <memory>
 #include <set>
+#include <span>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "dependency_extractor_export.h"
@@ -14,28 +19,55 @@ struct ExtractorOptions
     std::set<std::string> libraryDirs;
     std::set<std::string> scanDirs;
     std::set<std::string> systemDirs;
+    // Libraries provided by the platform without a directory to scan
+    std::set<std::string> systemLibraries;
+    // Directories inside archives (e.g. lib/<abi> of APK), searched before libraryDirs with the same tier
+    std::vector<std::pair<std::shared_ptr<const ZipArchive>, std::string>> archiveDirs;
 
-    std::unordered_map<std::string, std::string> libraryDirsFiles;
-    std::unordered_map<std::string, std::string> scanDirsFiles;
-    std::unordered_map<std::string, std::string> systemDirsFiles;
+    // Number of libraries scanned concurrently, 1 scans them one by one
+    unsigned jobs = 1;
+    // Optional, directory listings are reused from it when directory did not change
+    DirectoryCache* directoryCache = nullptr;
+
+    DirectoryIndex libraries;
 
     void preloadInfo(const std::string& libraryExtension);
-    std::vector<std::string> scanDirectory(const std::string& path, const std::string& libraryExtension);
-    std::unordered_map<std::string, std::string> scanDirectories(const std::set<std::string>& paths,
-                                                                 const std::string& libraryExtension);
 };
 
+// Lists are views over graph of all libraries visited during resolution,
+// use LibraryList::toSharedLibraries() to get plain SharedLibrary copies
 struct ResolveResult
 {
-    SharedLibraries resolved;
-    SharedLibraries availableForCopy;
-    SharedLibraries unmet;
+    std::shared_ptr<const DependencyGraph> graph;
+    LibraryId root = 0;
+    LibraryList resolved;
+    LibraryList availableForCopy;
+    LibraryList unmet;
 };
 
 class DEPENDENCY_EXTRACTOR_EXPORT DependencyExtractor
 {
 public:
+    using ScanCallback = std::function<void(SharedLibrary&)>;
+    // Returns libraries to be resolved as additional roots because library was found (e.g. its plugins)
+    using RootExpansion = std::function<std::vector<SharedLibrary>(const LibraryView& library)>;
+    // Called as soon as tier of library is known, requiredBy is null for roots given to resolveBatch.
+    // Returning false cancels the rest of resolution.
+    using ClassifyCallback = std::function<bool(const LibraryView& library, const LibraryView* requiredBy)>;
+
     DependencyExtractor() = default;
+    virtual ~DependencyExtractor() = default;
     virtual void scanDependencies(SharedLibrary& target) = 0;
-    virtual ResolveResult resolveDependencies(SharedLibrary& target, const ExtractorOptions& options) = 0;
+    // Scans all targets, onScanned (if set) is called for each of them, one at a time
+    virtual void scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs, const ScanCallback& onScanned);
+    virtual ResolveResult resolveDependencies(SharedLibrary& target, const ExtractorOptions& options);
+    // Resolves all targets in one pass over a shared graph, every library is scanned
+    // once and closures of common subgraphs are reused. Results are in targets order,
+    // followed by results of roots added by expand (called for every root and every
+    // library found in libraryDirs or scanDirs) in order they were added.
+    // onClassified (if set) is called from the calling thread while resolution goes on,
+    // once for every library. When it cancels, results cover only libraries found so far.
+    std::vector<ResolveResult> resolveBatch(std::span<const SharedLibrary> targets, const ExtractorOptions& options,
+                                            const RootExpansion& expand = {},
+                                            const ClassifyCallback& onClassified = {});
 };
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "dependency.h"
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+using LibraryId = uint32_t;
+using StringId = uint32_t;
+
+// Owns every distinct string once, views returned by it stay valid for the
+// whole lifetime of the pool.
+class DEPENDENCY_EXTRACTOR_EXPORT StringPool
+{
+public:
+    StringId intern(std::string_view text);
+    std::optional<StringId> find(std::string_view text) const;
+    std::string_view at(StringId id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockUsed = BLOCK_SIZE;
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, StringId> ids;
+};
+
+enum class LibraryTier : uint8_t
+{
+    Root,    // library resolution started from
+    Library, // found in libraryDirs, scanned
+    Scan,    // found in scanDirs, scanned and available for copy
+    System,  // provided by platform, not scanned
+    Unmet    // not found anywhere
+};
+
+// Libraries are nodes with integer ids, names and paths are interned and
+// dependencies of all nodes are kept in one edge array (each node owns a
+// contiguous range of it), so a graph costs a few flat vectors.
+class DEPENDENCY_EXTRACTOR_EXPORT DependencyGraph
+{
+public:
+    // Returns id of existing library with this name or adds a new one
+    LibraryId addLibrary(std::string_view name);
+    std::optional<LibraryId> find(std::string_view name) const;
+    size_t size() const { return nodes.size(); }
+
+    std::string_view name(LibraryId id) const { return strings.at(nodes[id].name); }
+    std::string_view path(LibraryId id) const { return strings.at(nodes[id].path); }
+    std::string_view soname(LibraryId id) const { return strings.at(nodes[id].soname); }
+    LibraryTier tier(LibraryId id) const { return nodes[id].tier; }
+    bool scanned(LibraryId id) const { return nodes[id].scanned; }
+    std::span<const LibraryId> dependencies(LibraryId id) const
+    {
+        return {edges.data() + nodes[id].edgeBegin, nodes[id].edgeCount};
+    }
+
+    void setPath(LibraryId id, std::string_view path) { nodes[id].path = strings.intern(path); }
+    void setTier(LibraryId id, LibraryTier tier) { nodes[id].tier = tier; }
+    // Stores scan result, dependencies are added to graph as new libraries when needed
+    void setScanResult(LibraryId id, const SharedLibrary& scanned);
+
+    SharedLibrary toSharedLibrary(LibraryId id) const;
+
+private:
+    struct Node
+    {
+        StringId name;
+        StringId path;
+        StringId soname;
+        uint32_t edgeBegin = 0;
+        uint32_t edgeCount = 0;
+        LibraryTier tier = LibraryTier::Unmet;
+        bool scanned = false;
+    };
+
+    StringPool strings;
+    StringId emptyString = strings.intern({});
+    std::vector<Node> nodes;
+    std::vector<LibraryId> edges;
+    std::unordered_map<StringId, LibraryId> byName;
+};
+
+// Memoized transitive closures over a finished graph. Strongly connected
+// components are found lazily (Tarjan), and closure of each component is
+// computed once from closures of components it depends on, so shared
+// subgraphs (e.g. Qt5Core with its dependencies) are walked only once.
+class DEPENDENCY_EXTRACTOR_EXPORT TransitiveClosures
+{
+public:
+    explicit TransitiveClosures(const DependencyGraph& graph);
+
+    // All libraries reachable from id (including id), sorted by id
+    const std::vector<LibraryId>& closure(LibraryId id);
+
+private:
+    static constexpr uint32_t UNVISITED = UINT32_MAX;
+
+    void computeComponents(LibraryId start);
+
+    const DependencyGraph& graph;
+    uint32_t nextIndex = 0;
+    std::vector<uint32_t> index;
+    std::vector<uint32_t> lowLink;
+    std::vector<uint32_t> component;
+    std::vector<char> onStack;
+    std::vector<LibraryId> stack;
+    std::vector<std::vector<LibraryId>> componentClosures;
+};
+
+class DEPENDENCY_EXTRACTOR_EXPORT LibraryView
+{
+public:
+    LibraryView(const DependencyGraph& graph, LibraryId id) : graph(&graph), libraryId(id) {}
+
+    LibraryId id() const { return libraryId; }
+    std::string_view name() const { return graph->name(libraryId); }
+    std::string_view path() const { return graph->path(libraryId); }
+    std::string_view soname() const { return graph->soname(libraryId); }
+    LibraryTier tier() const { return graph->tier(libraryId); }
+    bool scanned() const { return graph->scanned(libraryId); }
+    std::span<const LibraryId> dependencies() const { return graph->dependencies(libraryId); }
+
+    SharedLibrary toSharedLibrary() const { return graph->toSharedLibrary(libraryId); }
+
+private:
+    const DependencyGraph* graph;
+    LibraryId libraryId;
+};
+
+// Set of libraries of one graph, ordered by name
+class DEPENDENCY_EXTRACTOR_EXPORT LibraryList
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = LibraryView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = LibraryView;
+
+        Iterator() = default;
+        Iterator(const DependencyGraph* graph, std::vector<LibraryId>::const_iterator it) : graph(graph), it(it) {}
+
+        LibraryView operator*() const { return {*graph, *it}; }
+        Iterator& operator++()
+        {
+            ++it;
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            auto copy = *this;
+            ++it;
+            return copy;
+        }
+        bool operator==(const Iterator& other) const { return it == other.it; }
+
+    private:
+        const DependencyGraph* graph = nullptr;
+        std::vector<LibraryId>::const_iterator it;
+    };
+
+    LibraryList() = default;
+    LibraryList(std::shared_ptr<const DependencyGraph> graph, std::vector<LibraryId> ids);
+
+    Iterator begin() const { return {graph.get(), libraryIds.cbegin()}; }
+    Iterator end() const { return {graph.get(), libraryIds.cend()}; }
+    size_t size() const { return libraryIds.size(); }
+    bool empty() const { return libraryIds.empty(); }
+    bool contains(std::string_view name) const;
+    const std::vector<LibraryId>& ids() const { return libraryIds; }
+
+    SharedLibraries toSharedLibraries() const;
+
+private:
+    std::shared_ptr<const DependencyGraph> graph;
+    std::vector<LibraryId> libraryIds;
+};
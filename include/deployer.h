@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+struct stat;
+
+// Copies libraries into deploy directory, skipping those already deployed.
+// Target is unchanged when it has the same size and mtime as source (mtime is
+// copied with file) or the same content. Otherwise file is reflinked, hardlinked
+// (when allowed), copied with copy_file_range or, as last resort, by read/write,
+// always into temporary file renamed over target, so readers never see partial
+// file. With stripping enabled, ELF files are deployed without unloaded
+// sections (debug info, symbol table), stripped copies are kept in cache
+// directory keyed by content of source, so each version is stripped once, and
+// found by device, inode, size and mtime of source, so it is hashed only when
+// that changes.
+// Deployer can be shared by several threads.
+class DEPENDENCY_EXTRACTOR_EXPORT Deployer
+{
+public:
+    enum class Method
+    {
+        Unchanged,
+        Cloned,
+        Linked,
+        Copied,
+        Failed
+    };
+
+    struct Stats
+    {
+        size_t unchanged = 0;
+        size_t cloned = 0;
+        size_t linked = 0;
+        size_t copied = 0;
+        size_t failed = 0;
+        // Bytes written to deploy directory
+        uint64_t bytesWritten = 0;
+        // Bytes not written thanks to unchanged targets, reflinks and hardlinks
+        uint64_t bytesAvoided = 0;
+        // Files deployed stripped and bytes removed from them
+        size_t stripped = 0;
+        uint64_t bytesStripped = 0;
+    };
+
+    explicit Deployer(bool allowHardlinks = false);
+
+    // Deploys stripped ELF files, cacheDirectory must exist
+    void enableStripping(std::string cacheDirectory);
+
+    // Deploys all files into directory using up to jobs threads, returns false if any of them failed
+    bool deploy(std::span<const std::string> files, const std::string& directory, unsigned jobs);
+
+    Stats stats() const;
+
+    // Deploys one file into directory
+    Method deployFile(const std::string& source, const std::string& directory);
+
+private:
+    // Path of stripped copy of source in cache, created when missing
+    std::optional<std::string> strippedCopy(const std::string& source, const std::string& name,
+                                            const struct stat& sourceInfo);
+
+    bool hardlinks;
+    std::string stripCache;
+    std::atomic<size_t> unchanged = 0;
+    std::atomic<size_t> cloned = 0;
+    std::atomic<size_t> linked = 0;
+    std::atomic<size_t> copied = 0;
+    std::atomic<size_t> failed = 0;
+    std::atomic<uint64_t> bytesWritten = 0;
+    std::atomic<uint64_t> bytesAvoided = 0;
+    std::atomic<size_t> stripped = 0;
+    std::atomic<uint64_t> bytesStripped = 0;
+};
+
+// Deploys files on background workers while they are still being found, so
+// copying overlaps with resolution. Every file is deployed once, however many
+// times it is added.
+class DEPENDENCY_EXTRACTOR_EXPORT DeployQueue
+{
+public:
+    using Callback = std::function<void(const std::string& source, Deployer::Method method)>;
+
+    // onDeployed (if set) is called from workers, one at a time
+    DeployQueue(Deployer& deployer, std::string directory, unsigned jobs, Callback onDeployed = {});
+    DeployQueue(const DeployQueue&) = delete;
+    DeployQueue& operator=(const DeployQueue&) = delete;
+    ~DeployQueue();
+
+    void add(const std::string& file);
+    // Drops files that were not deployed yet
+    void cancel();
+    // Waits until all added files are deployed, returns false if any of them failed
+    bool finish();
+
+private:
+    void work();
+
+    Deployer& deployer;
+    std::string directory;
+    Callback onDeployed;
+    std::mutex mutex;
+    std::mutex callbackMutex;
+    std::condition_variable available;
+    std::deque<std::string> pending;
+    std::set<std::string> added;
+    bool finished = false;
+    bool failed = false;
+    std::vector<std::jthread> workers;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "dependencygraph.h"
+#include "ziparchive.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Persistent listings of library directories. A listing is valid as long as
+// mtime of its directory is unchanged (creating, removing or renaming a file
+// updates it), so unchanged sysroots and Qt installations are not read again.
+// One cache can be shared by several threads.
+class DEPENDENCY_EXTRACTOR_EXPORT DirectoryCache
+{
+public:
+    explicit DirectoryCache(std::string path);
+
+    bool load();
+    bool save();
+
+    std::optional<std::vector<std::string>> lookup(const std::string& directory, const std::string& extension,
+                                                   int64_t mtime);
+    void store(const std::string& directory, const std::string& extension, int64_t mtime,
+               std::vector<std::string> names);
+    // Drops listing of directory, it is read again even if its mtime did not change
+    void invalidate(const std::string& directory);
+
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+
+private:
+    struct Listing
+    {
+        int64_t mtime = 0;
+        std::string extension;
+        std::vector<std::string> names;
+    };
+
+    std::string cachePath;
+    std::mutex mutex;
+    std::unordered_map<std::string, Listing> listings;
+    bool modified = false;
+    std::atomic<size_t> hitCount = 0;
+    std::atomic<size_t> missCount = 0;
+};
+
+// Location of every library from library, scan and system directories. Names
+// are interned and refer to their directory by index, so each directory path
+// is stored once. Names absent from the index are rejected by a bloom filter
+// before touching the hash table.
+class DEPENDENCY_EXTRACTOR_EXPORT DirectoryIndex
+{
+public:
+    struct Directory
+    {
+        LibraryTier tier;
+        std::string path;
+    };
+
+    struct Location
+    {
+        LibraryTier tier;
+        std::string path;
+    };
+
+    // Lists directories in parallel (reusing cache listings when given) and adds
+    // their libraries. Names already present are kept, so earlier directories
+    // take precedence.
+    void addDirectories(std::span<const Directory> paths, const std::string& extension, unsigned jobs,
+                        DirectoryCache* cache = nullptr);
+    // Adds libraries of directory inside archive, their path is <archive>!/<directory>/<name>
+    void addArchiveDirectory(LibraryTier tier, const ZipArchive& archive, const std::string& directory,
+                             const std::string& extension);
+    // Adds libraries without directory, their path is just their name
+    void addLibraries(LibraryTier tier, const std::set<std::string>& names);
+
+    std::optional<Location> find(std::string_view name) const;
+    size_t size() const { return entries.size(); }
+    size_t size(LibraryTier tier) const;
+
+private:
+    static constexpr uint32_t NO_DIRECTORY = UINT32_MAX;
+
+    struct Entry
+    {
+        LibraryTier tier;
+        uint32_t directory;
+    };
+
+    void add(LibraryTier tier, uint32_t directory, std::string_view name);
+    void rebuildFilter();
+    bool mayContain(std::string_view name) const;
+
+    std::vector<std::string> directories;
+    // Indexed by StringId of name
+    StringPool names;
+    std::vector<Entry> entries;
+    std::vector<uint64_t> filter;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "dependencyextractor.h"
+#include "libraryfile.h"
+
+#include <memory>
+
+#include "dependency_extractor_export.h"
+
+// Reads DT_NEEDED/DT_SONAME straight from the dynamic segment of mapped ELF
+// files, so no external tool (and no NDK) is needed to scan libraries.
+// Libraries inside added archives are read from <archive>!/<entry> paths.
+class DEPENDENCY_EXTRACTOR_EXPORT ElfDependencyExtractor : public DependencyExtractor
+{
+public:
+    ElfDependencyExtractor() = default;
+
+    void addArchive(std::shared_ptr<const ZipArchive> archive);
+    void scanDependencies(SharedLibrary& target) override;
+
+private:
+    Archives archives;
+};
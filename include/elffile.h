@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+namespace Elf {
+constexpr int64_t DT_NULL = 0;
+constexpr int64_t DT_NEEDED = 1;
+constexpr int64_t DT_PLTRELSZ = 2;
+constexpr int64_t DT_HASH = 4;
+constexpr int64_t DT_STRTAB = 5;
+constexpr int64_t DT_SYMTAB = 6;
+constexpr int64_t DT_RELA = 7;
+constexpr int64_t DT_RELASZ = 8;
+constexpr int64_t DT_RELAENT = 9;
+constexpr int64_t DT_STRSZ = 10;
+constexpr int64_t DT_INIT = 12;
+constexpr int64_t DT_SONAME = 14;
+constexpr int64_t DT_RELSZ = 18;
+constexpr int64_t DT_RELENT = 19;
+constexpr int64_t DT_PLTREL = 20;
+constexpr int64_t DT_INIT_ARRAYSZ = 27;
+constexpr int64_t DT_RELRSZ = 35;
+constexpr int64_t DT_RELR = 36;
+constexpr int64_t DT_ANDROID_REL = 0x6000000f;
+constexpr int64_t DT_ANDROID_RELSZ = 0x60000010;
+constexpr int64_t DT_ANDROID_RELA = 0x60000011;
+constexpr int64_t DT_ANDROID_RELASZ = 0x60000012;
+constexpr int64_t DT_ANDROID_RELR = 0x6fffe000;
+constexpr int64_t DT_ANDROID_RELRSZ = 0x6fffe001;
+constexpr int64_t DT_GNU_HASH = 0x6ffffef5;
+
+constexpr uint8_t STB_LOCAL = 0;
+constexpr uint8_t STB_GLOBAL = 1;
+constexpr uint8_t STB_WEAK = 2;
+constexpr uint8_t STB_GNU_UNIQUE = 10;
+constexpr uint16_t SHN_UNDEF = 0;
+
+constexpr uint32_t SHT_RELA = 4;
+constexpr uint32_t SHT_NOTE = 7;
+constexpr uint32_t SHT_NOBITS = 8;
+constexpr uint32_t SHT_REL = 9;
+constexpr uint32_t SHT_ARM_ATTRIBUTES = 0x70000003;
+constexpr uint64_t SHF_ALLOC = 0x2;
+constexpr uint64_t SHF_EXECINSTR = 0x4;
+constexpr uint64_t SHF_INFO_LINK = 0x40;
+
+constexpr uint32_t PT_LOAD = 1;
+constexpr uint32_t PT_DYNAMIC = 2;
+} // namespace Elf
+
+// Read-only view over an ELF32/ELF64 image of either byte order. All returned
+// strings point into the underlying buffer, which has to outlive the object.
+// Const methods are not thread-safe until symbol tables are located (first
+// call of dynamicSymbolCount()), so call it before sharing object between threads.
+class DEPENDENCY_EXTRACTOR_EXPORT ElfFile
+{
+public:
+    struct DynamicEntry
+    {
+        int64_t tag;
+        uint64_t value;
+    };
+
+    struct Symbol
+    {
+        std::string_view name;
+        uint8_t binding;
+        uint8_t type;
+        uint16_t section;
+
+        bool isDefined() const { return section != Elf::SHN_UNDEF; }
+        bool isExported() const
+        {
+            return isDefined() &&
+                   (binding == Elf::STB_GLOBAL || binding == Elf::STB_WEAK || binding == Elf::STB_GNU_UNIQUE);
+        }
+    };
+
+    struct Section
+    {
+        uint32_t name;
+        uint32_t type;
+        uint64_t flags;
+        uint64_t address;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t link;
+        uint32_t info;
+        uint64_t alignment;
+        uint64_t entrySize;
+    };
+
+    // Work of dynamic linker when library is loaded, relocation tables are
+    // counted from their sizes, packed (Android APS2, RELR) ones are decoded.
+    struct LoadCost
+    {
+        uint64_t relocations = 0;
+        uint64_t pltRelocations = 0;
+        uint64_t initFunctions = 0;
+    };
+
+    explicit ElfFile(std::span<const std::byte> image);
+
+    bool isValid() const { return errorMessage.empty(); }
+    const std::string& errorString() const { return errorMessage; }
+
+    bool is64Bit() const { return elf64; }
+    bool isBigEndian() const { return bigEndian; }
+    uint16_t machine() const { return machineType; }
+
+    const std::vector<DynamicEntry>& dynamicEntries() const { return dynamic; }
+    std::optional<uint64_t> dynamicValue(int64_t tag) const;
+
+    std::vector<std::string_view> neededLibraries() const;
+    std::string_view soname() const;
+
+    std::optional<uint64_t> fileOffset(uint64_t address) const;
+    std::string_view dynamicString(uint64_t offset) const;
+
+    // Dynamic symbol table, its size is taken from DT_HASH or DT_GNU_HASH. Symbol
+    // tables are located on first use (not synchronized), so reading only DT_NEEDED does not pay for it.
+    size_t dynamicSymbolCount() const;
+    Symbol dynamicSymbol(size_t index) const;
+    // Looks symbol up in DT_GNU_HASH (bloom filter, then bucket chain), DT_HASH
+    // or, without hash tables, in whole table. hash is gnuHash(name).
+    bool exportsSymbol(std::string_view name, uint32_t hash) const;
+
+    LoadCost loadCost() const;
+
+    // Section header table, empty if there is none or it is outside of file
+    std::vector<Section> sections() const;
+    uint16_t sectionNamesIndex() const;
+    // Name of section in names table of sections (sections()[sectionNamesIndex()])
+    std::string_view sectionName(const Section& section, const Section& names) const;
+    // Content of section in file, empty for SHT_NOBITS or if it is outside of file
+    std::span<const std::byte> sectionContent(const Section& section) const;
+    // End of ELF header, program headers and all segments in file, bytes after it are not loaded
+    uint64_t segmentsSize() const { return segmentsEnd; }
+
+    static uint32_t gnuHash(std::string_view name);
+    static uint32_t sysvHash(std::string_view name);
+
+private:
+    struct Segment
+    {
+        uint64_t offset;
+        uint64_t address;
+        uint64_t fileSize;
+    };
+
+    bool fits(uint64_t offset, uint64_t size) const;
+    uint64_t read(uint64_t offset, size_t size) const;
+    uint64_t readWord(uint64_t offset) const { return read(offset, elf64 ? 8 : 4); }
+
+    void parseHeader();
+    void parseDynamic(uint64_t offset, uint64_t size);
+    void parseSymbolTables() const;
+    bool lookupGnuHash(std::string_view name, uint32_t hash) const;
+    bool lookupSysvHash(std::string_view name) const;
+    uint64_t packedRelocationCount(int64_t tableTag) const;
+    uint64_t relrRelocationCount(int64_t tableTag, int64_t sizeTag) const;
+
+    std::span<const std::byte> data;
+    std::string errorMessage;
+    bool elf64 = false;
+    bool bigEndian = false;
+    uint16_t machineType = 0;
+    uint64_t segmentsEnd = 0;
+    std::vector<Segment> loadSegments;
+    std::vector<DynamicEntry> dynamic;
+    std::string_view stringTable;
+
+    mutable bool symbolsParsed = false;
+    mutable uint64_t symbolTable = 0;
+    mutable size_t symbolCount = 0;
+    // Offsets of hash tables in file, 0 if there is none
+    mutable uint64_t gnuHashTable = 0;
+    mutable uint64_t sysvHashTable = 0;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "dependency_extractor_export.h"
+
+// Writes ELF image without sections that are not loaded (debug info, symbol
+// table, comments), like llvm-strip --strip-all. Loaded part of image is copied
+// unchanged, kept unloaded sections (section names, notes, ARM attributes) and
+// rewritten section header table follow it, so output is written sequentially
+// in one pass.
+namespace ElfStripper {
+// Returns size written to fd, nothing if image is not ELF or has nothing to strip
+DEPENDENCY_EXTRACTOR_EXPORT std::optional<uint64_t> strip(std::span<const std::byte> image, int fd);
+} // namespace ElfStripper
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dependency.h"
+#include "dependency_extractor_export.h"
+
+namespace spdlog {
+class logger;
+}
+
+// Applications and extra libraries resolved in one pass: application given on
+// command line and those listed in manifest, e.g.
+// {"applications": ["app"], "libraries": ["/path/libplugin_${ANDROID_ABI}.so"]}
+class DEPENDENCY_EXTRACTOR_EXPORT EntryPoints
+{
+public:
+    // Adds application (if not empty) and content of manifest (if it exists), returns false if manifest is invalid
+    bool load(const std::string& appName, const std::string& manifestFile);
+
+    const std::vector<std::string>& applications() const { return applicationNames; }
+    const std::vector<std::string>& libraryPatterns() const { return libraries; }
+
+    // Existing libraries of architecture, missing ones are reported to log
+    std::vector<SharedLibrary> librariesOf(const std::string& abi, spdlog::logger& log) const;
+
+    // Library path with ${ANDROID_ABI} replaced
+    static std::string libraryPath(std::string pattern, const std::string& abi);
+
+private:
+    std::vector<std::string> applicationNames;
+    std::vector<std::string> libraries;
+};
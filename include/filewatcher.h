@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Reports changes of files in watched directories (not recursive) using
+// inotify. Descriptor is non-blocking, so it can be polled together with
+// other descriptors.
+class DEPENDENCY_EXTRACTOR_EXPORT FileWatcher
+{
+public:
+    struct Changes
+    {
+        // Files written, created, removed or renamed
+        std::vector<std::string> files;
+        // Directories where file was created, removed or renamed
+        std::vector<std::string> directories;
+        // Kernel queue overflowed, anything could have changed
+        bool lost = false;
+
+        bool empty() const { return files.empty() && directories.empty() && !lost; }
+    };
+
+    FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher();
+
+    bool isValid() const { return fd >= 0; }
+    int descriptor() const { return fd; }
+
+    bool watch(const std::string& directory);
+    // Returns all pending changes, empty if there are none
+    Changes readChanges();
+
+private:
+    int fd = -1;
+    std::unordered_map<int, std::string> directories;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "mappedfile.h"
+#include "ziparchive.h"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+using Archives = std::vector<std::shared_ptr<const ZipArchive>>;
+
+// Content of library, either mapped file or entry of one of archives when path
+// has <archive>!/<entry> form. Stored entries are not copied.
+class DEPENDENCY_EXTRACTOR_EXPORT LibraryFile
+{
+public:
+    bool open(const std::string& path, const Archives& archives);
+
+    std::span<const std::byte> bytes() const { return content; }
+
+private:
+    MappedFile file;
+    std::vector<std::byte> inflated;
+    std::span<const std::byte> content;
+};
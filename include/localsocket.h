@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "dependency_extractor_export.h"
+
+// Minimal helpers for request/reply over Unix domain stream sockets. All
+// functions return -1 or false on failure, after logging the reason.
+namespace LocalSocket {
+// Listens on path, stale socket file left by previous server is replaced
+DEPENDENCY_EXTRACTOR_EXPORT int listen(const std::string& path);
+DEPENDENCY_EXTRACTOR_EXPORT int connect(const std::string& path);
+DEPENDENCY_EXTRACTOR_EXPORT int accept(int listenFd);
+
+DEPENDENCY_EXTRACTOR_EXPORT bool sendAll(int fd, std::string_view data);
+// Reads up to newline (not included) or end of stream, fails when line does not
+// arrive within timeoutMs or is longer than maxLength
+DEPENDENCY_EXTRACTOR_EXPORT std::optional<std::string> receiveLine(int fd, int timeoutMs, size_t maxLength);
+// Reads until peer closes connection
+DEPENDENCY_EXTRACTOR_EXPORT std::string receiveAll(int fd);
+} // namespace LocalSocket
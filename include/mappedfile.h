@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+#include "dependency_extractor_export.h"
+
+class DEPENDENCY_EXTRACTOR_EXPORT MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return opened; }
+    const std::byte* data() const { return address; }
+    size_t size() const { return length; }
+    std::span<const std::byte> bytes() const { return {address, length}; }
+
+private:
+    const std::byte* address = nullptr;
+    size_t length = 0;
+    bool opened = false;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+inline unsigned defaultJobs()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls function(index) for every index in [0, count) using up to jobs threads
+template <typename Function>
+void forEachIndex(size_t count, unsigned jobs, Function&& function)
+{
+    auto workerCount = std::min<size_t>(jobs, count);
+    if (workerCount <= 1)
+    {
+        for (size_t index = 0; index < count; ++index)
+            function(index);
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::vector<std::jthread> workers;
+    workers.reserve(workerCount);
+    for (size_t worker = 0; worker < workerCount; ++worker)
+        workers.emplace_back([&]() {
+            for (auto index = next++; index < count; index = next++)
+                function(index);
+        });
+}
+} // namespace Parallel
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Decides which Qt plugins an application uses, so that plugins of a module it
+// does not need (image formats, input contexts, icon engines of Qt5Gui, ...)
+// are neither deployed nor scanned by Qt at startup. Plugin is kept only with
+// evidence: it is required (platform plugin), allowed by name or type, its
+// class name or interface IID is referenced from loaded sections of
+// application libraries (Q_IMPORT_PLUGIN, qobject_cast, plugin keys used by
+// name) or its Qt module is imported from QML files of application.
+class DEPENDENCY_EXTRACTOR_EXPORT PluginUsage
+{
+public:
+    struct Plugin
+    {
+        // Qt module, e.g. Qt5Gui
+        std::string module;
+        // Plugin class, e.g. QJpegPlugin
+        std::string className;
+        // Directory in <qt>/plugins, e.g. imageformats
+        std::string type;
+        std::string path;
+    };
+
+    enum class Evidence
+    {
+        None,
+        Required,
+        Allowlist,
+        Reference,
+        QmlImport
+    };
+
+    // Class name (QJpegPlugin) or type (imageformats) of plugins that are always kept
+    void allow(std::string nameOrType);
+    // Collects modules imported by .qml files under directory
+    void addQmlDirectory(const std::string& directory);
+
+    // Evidence for each of plugins, application libraries are searched using up to jobs threads
+    std::vector<Evidence> evaluate(std::span<const Plugin> plugins, std::span<const std::string> applicationLibraries,
+                                   unsigned jobs) const;
+
+    // Plugin of <module>_<Class>.cmake metadata, path is relative to plugins directory for its type
+    static Plugin plugin(std::string_view module, std::string_view metadataName, std::string_view relativePath,
+                         std::string path);
+    // Interface IIDs (strings with dots) in .qtmetadata section of plugin, both
+    // Qt 5 binary JSON and Qt 6 CBOR keep them as plain text
+    static std::vector<std::string> interfaceIds(std::span<const std::byte> pluginImage);
+    static const char* evidenceName(Evidence evidence);
+
+private:
+    bool isImportedFromQml(const std::string& module) const;
+
+    std::set<std::string> allowlist;
+    // Imports without dots and leading Qt, e.g. QuickVirtualKeyboard for QtQuick.VirtualKeyboard
+    std::set<std::string> qmlImports;
+};
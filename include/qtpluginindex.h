@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mappedfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Plugins of every Qt module, read from <qt>/lib/cmake/<Module>/<Module>_*Plugin.cmake.
+// Index is a sorted table of modules and their plugins followed by a string
+// blob, the same bytes are kept in memory and in index file, so a saved index
+// is used directly from mmap. Saved index is valid as long as mtime of
+// lib/cmake and of every module directory in it is unchanged.
+class DEPENDENCY_EXTRACTOR_EXPORT QtPluginIndex
+{
+public:
+    struct Plugin
+    {
+        std::string_view name;
+        // Relative to <qt>/plugins, contains ${ANDROID_ABI}; empty if metadata has no release path
+        std::string_view path;
+    };
+
+    explicit QtPluginIndex(std::string qtPath);
+
+    // Parses metadata of all modules using up to jobs threads
+    void build(unsigned jobs);
+    // Uses index file if it is valid for this Qt installation, otherwise builds and saves it
+    void open(const std::string& indexPath, unsigned jobs);
+
+    // Module is library base name, e.g. Qt5Gui
+    std::vector<Plugin> plugins(std::string_view module) const;
+    size_t moduleCount() const;
+    // lib/cmake, directories of modules and plugin metadata files the index was built from
+    std::vector<std::string> metadataFiles() const;
+    // Full path of plugin library for abi, empty if plugin has no ABI specific path
+    std::string pluginPath(const Plugin& plugin, const std::string& abi) const;
+
+    // Module of library, e.g. Qt5Gui for libQt5Gui_x86.so
+    static std::string moduleName(const std::string& libraryName);
+
+private:
+    bool isValid(std::span<const std::byte> bytes) const;
+    bool isCurrent(std::span<const std::byte> bytes) const;
+
+    std::string qt;
+    MappedFile mapping;
+    std::string built;
+    std::span<const std::byte> indexBytes;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "dependency.h"
+#include "mappedfile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Persistent store of scan results (DT_NEEDED list and SONAME) of single files.
+// Saved file is a sorted table of fixed size records followed by a string blob,
+// so loading it is just a mmap and lookups are a binary search over mapping.
+class DEPENDENCY_EXTRACTOR_EXPORT ScanCache
+{
+public:
+    enum class Validation : uint32_t
+    {
+        FileIdentity, // size + mtime + inode
+        ContentHash   // size + hash of whole file
+    };
+
+    explicit ScanCache(std::string path, Validation validation = Validation::FileIdentity);
+
+    bool load();
+    bool save();
+
+    // Fills dependencies and soname of target if there is a valid entry for its path
+    bool lookup(SharedLibrary& target);
+    void store(const SharedLibrary& target);
+    // Drops entry of path, it is scanned again even if its size and mtime did not change
+    void invalidate(const std::string& path);
+
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+
+private:
+    struct FileKey
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t inode = 0;
+        uint64_t contentHash = 0;
+
+        bool operator==(const FileKey&) const = default;
+    };
+
+    struct Entry
+    {
+        FileKey key;
+        std::string soname;
+        std::vector<std::string> dependencies;
+    };
+
+    std::optional<FileKey> fileKey(const std::string& path) const;
+    std::optional<Entry> mappedEntry(const std::string& path) const;
+
+    std::string cachePath;
+    Validation mode;
+    MappedFile mapping;
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> updated;
+    std::unordered_set<std::string> invalidated;
+    std::atomic<size_t> hitCount = 0;
+    std::atomic<size_t> missCount = 0;
+};
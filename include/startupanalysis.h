@@ -0,0 +1,65 @@
+#pragma once
+
+#include "dependencygraph.h"
+#include "libraryfile.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Cold start cost of loading libraries of a resolved graph. Libraries are
+// listed in order bionic linker loads them (breadth first over DT_NEEDED in
+// file order, every library once). Platform libraries are already mapped into
+// every process by zygote, so they are neither listed nor counted.
+class DEPENDENCY_EXTRACTOR_EXPORT StartupAnalysis
+{
+public:
+    struct Cost
+    {
+        size_t libraries = 0;
+        uint64_t fileSize = 0;
+        uint64_t relocations = 0;
+        uint64_t pltRelocations = 0;
+        uint64_t symbols = 0;
+        uint64_t initFunctions = 0;
+
+        Cost& operator+=(const Cost& other);
+    };
+
+    struct LibraryCost
+    {
+        LibraryId library;
+        // False when library cannot be read (e.g. missing), its cost is then zero
+        bool readable = false;
+        Cost cost;
+    };
+
+    struct DependencyCost
+    {
+        LibraryId dependency;
+        // All libraries dependency loads
+        Cost total;
+        // Libraries loaded only because of this dependency, dropping it saves this much
+        Cost exclusive;
+    };
+
+    struct Report
+    {
+        LibraryId root;
+        std::vector<LibraryCost> loadOrder;
+        Cost total;
+        // Direct dependencies of root in DT_NEEDED order
+        std::vector<DependencyCost> dependencies;
+    };
+
+    // Libraries with <archive>!/<entry> paths are read from added archives
+    void addArchive(std::shared_ptr<const ZipArchive> archive);
+    // Every library of graph is read once, even if several roots load it
+    std::vector<Report> analyze(const DependencyGraph& graph, std::span<const LibraryId> roots, unsigned jobs);
+
+private:
+    Archives archives;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "dependencygraph.h"
+#include "libraryfile.h"
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Checks that undefined dynamic symbols of libraries are exported by their
+// transitive dependencies, so version mismatches of Qt or sysroot libraries
+// are found before dlopen fails on device. Every file is mapped once and
+// symbols are looked up through hash tables of dependencies, symbol versions
+// are not taken into account. The same imports show dependencies a library
+// links against without using any of their symbols.
+class DEPENDENCY_EXTRACTOR_EXPORT SymbolVerifier
+{
+public:
+    struct Unresolved
+    {
+        LibraryId library;
+        std::vector<std::string> symbols;
+    };
+
+    struct UnusedDependency
+    {
+        LibraryId library;
+        LibraryId dependency;
+    };
+
+    // Libraries with <archive>!/<entry> paths are read from added archives
+    void addArchive(std::shared_ptr<const ZipArchive> archive);
+    // Verifies libraries of graph (root, library and scan tiers, others are
+    // only used as providers). Libraries depending on a library that cannot be
+    // read (e.g. platform library without sysroot) are skipped, as its exports are unknown.
+    std::vector<Unresolved> verify(const DependencyGraph& graph, std::span<const LibraryId> libraries,
+                                   unsigned jobs);
+
+    // Direct dependencies (DT_NEEDED) of libraries that export none of their undefined
+    // symbols. Dependencies that cannot be read are not reported. Such dependency may
+    // still be needed for its initializers or for code loaded later, so edges are candidates.
+    std::vector<UnusedDependency> findUnusedDependencies(const DependencyGraph& graph,
+                                                         std::span<const LibraryId> libraries, unsigned jobs);
+    // Libraries reachable from roots that would not be reachable without removed edges
+    static std::vector<LibraryId> droppedLibraries(const DependencyGraph& graph, std::span<const LibraryId> roots,
+                                                   std::span<const UnusedDependency> removed);
+
+    size_t verifiedCount() const { return verified; }
+    size_t skippedCount() const { return skipped; }
+
+private:
+    Archives archives;
+    size_t verified = 0;
+    size_t skipped = 0;
+};
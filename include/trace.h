@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "dependency_extractor_export.h"
+
+// Timings and counters of all phases. Recording is off by default and then
+// every call below is a single relaxed load of a flag.
+namespace Trace {
+namespace detail {
+DEPENDENCY_EXTRACTOR_EXPORT extern std::atomic<bool> active;
+DEPENDENCY_EXTRACTOR_EXPORT void complete(const char* name, std::string_view detail, uint64_t start, uint64_t end);
+DEPENDENCY_EXTRACTOR_EXPORT void counter(const char* name, int64_t value);
+} // namespace detail
+
+DEPENDENCY_EXTRACTOR_EXPORT void setEnabled(bool enabled);
+inline bool enabled()
+{
+    return detail::active.load(std::memory_order_relaxed);
+}
+
+// Monotonic time in nanoseconds
+DEPENDENCY_EXTRACTOR_EXPORT uint64_t now();
+
+// Records span that was measured by caller
+inline void complete(const char* name, std::string_view detail, uint64_t start, uint64_t end)
+{
+    if (enabled())
+        detail::complete(name, detail, start, end);
+}
+
+inline void counter(const char* name, int64_t value)
+{
+    if (enabled())
+        detail::counter(name, value);
+}
+
+// Records time between construction and destruction
+class Scope
+{
+public:
+    explicit Scope(const char* name, std::string_view detail = {})
+    {
+        if (enabled())
+        {
+            eventName = name;
+            eventDetail = detail;
+            start = now();
+        }
+    }
+    ~Scope()
+    {
+        if (eventName)
+            detail::complete(eventName, eventDetail, start, now());
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* eventName = nullptr;
+    std::string eventDetail;
+    uint64_t start = 0;
+};
+
+// Chrome trace-event JSON (chrome://tracing, Perfetto)
+DEPENDENCY_EXTRACTOR_EXPORT bool writeChromeTrace(const std::string& path);
+// Table with count/total/average/max per span name and counter statistics
+DEPENDENCY_EXTRACTOR_EXPORT std::string summary();
+} // namespace Trace
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mappedfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "dependency_extractor_export.h"
+
+// Read-only ZIP archive (APK, AAB) mapped into memory. Only central directory
+// is parsed on open. Stored entries (native libraries of APKs are stored and
+// page aligned) are used in place, deflated ones are inflated into memory, so
+// nothing is extracted to disk. Entries of one archive can be read by several
+// threads. Entries inside archives are addressed as <archive>!/<entry>, like
+// Android does.
+class DEPENDENCY_EXTRACTOR_EXPORT ZipArchive
+{
+public:
+    struct Entry
+    {
+        std::string_view name;
+        uint16_t method = 0;
+        uint64_t compressedSize = 0;
+        uint64_t size = 0;
+        uint64_t localHeaderOffset = 0;
+    };
+
+    bool open(const std::string& path);
+
+    const std::string& path() const { return archivePath; }
+    const std::string& errorString() const { return errorMessage; }
+    std::span<const Entry> entries() const { return entryList; }
+    const Entry* find(std::string_view name) const;
+    // Content of entry, either view of mapped archive or of buffer it was inflated into
+    std::optional<std::span<const std::byte>> read(const Entry& entry, std::vector<std::byte>& buffer) const;
+
+    static std::string entryPath(const std::string& archive, std::string_view entry);
+    // Archive and entry of <archive>!/<entry> path
+    static std::optional<std::pair<std::string, std::string>> splitPath(std::string_view path);
+
+private:
+    bool fail(std::string message);
+    bool readCentralDirectory(uint64_t offset, uint64_t size, uint64_t count);
+
+    std::string archivePath;
+    std::string errorMessage;
+    MappedFile file;
+    // Sorted by name
+    std::vector<Entry> entryList;
+};
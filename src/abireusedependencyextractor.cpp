@@ -0,0 +1,148 @@
+#include "abireusedependencyextractor.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+
+#include "contenthash.h"
+#include "elffile.h"
+#include "libraryfile.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+constexpr std::string_view ABI_PLACEHOLDER = "${ANDROID_ABI}";
+constexpr std::string_view LIBRARY_SUFFIX = ".so";
+
+uint64_t nameHash(std::string_view name)
+{
+    return contentHash({reinterpret_cast<const std::byte*>(name.data()), name.size()});
+}
+
+uint64_t hashNeeded(std::string_view soname, std::vector<std::string_view> needed, std::string_view abi)
+{
+    // Duplicate DT_NEEDED entries count once, as in SharedLibrary::dependencies of reference
+    std::sort(needed.begin(), needed.end());
+    needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+    // Sum does not depend on order of DT_NEEDED entries, soname is told apart by multiplier
+    uint64_t hash = nameHash(AbiReuseDependencyExtractor::neutralName(soname, abi)) * 0x9e3779b97f4a7c15ull;
+    for (auto name : needed)
+        hash += nameHash(AbiReuseDependencyExtractor::neutralName(name, abi));
+    return hash;
+}
+
+std::string fileName(const std::string& path)
+{
+    return std::filesystem::path(path).filename().string();
+}
+} // namespace
+
+void AbiReuseDependencyExtractor::Reference::store(const SharedLibrary& library, const std::string& abi)
+{
+    if (!library.scanned)
+        return;
+    Entry entry{.neededHash = neededHash(library, abi),
+                .library = {.soname = neutralName(library.soname, abi), .scanned = true}};
+    for (const auto& dependency : library.dependencies)
+        entry.library.dependencies.insert(neutralName(dependency, abi));
+    auto key = neutralName(fileName(library.path), abi);
+    std::lock_guard lock(mutex);
+    libraries.insert_or_assign(std::move(key), std::move(entry));
+}
+
+bool AbiReuseDependencyExtractor::Reference::find(SharedLibrary& library, const std::string& abi,
+                                                  uint64_t neededHash) const
+{
+    std::lock_guard lock(mutex);
+    auto it = libraries.find(neutralName(fileName(library.path), abi));
+    if (it == libraries.end() || it->second.neededHash != neededHash)
+        return false;
+    library.soname = abiName(it->second.library.soname, abi);
+    for (const auto& dependency : it->second.library.dependencies)
+        library.dependencies.insert(abiName(dependency, abi));
+    library.scanned = true;
+    return true;
+}
+
+AbiReuseDependencyExtractor::AbiReuseDependencyExtractor(std::unique_ptr<DependencyExtractor> backend,
+                                                         Reference& reference, std::string abi, bool record)
+    : backend(std::move(backend)), reference(reference), abi(std::move(abi)), record(record)
+{
+}
+
+void AbiReuseDependencyExtractor::scanDependencies(SharedLibrary& target)
+{
+    if (!record && reuse(target))
+        return;
+    backend->scanDependencies(target);
+    if (record)
+        reference.store(target, abi);
+}
+
+void AbiReuseDependencyExtractor::scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs,
+                                            const ScanCallback& onScanned)
+{
+    if (record)
+    {
+        backend->scanBatch(targets, jobs, [&](SharedLibrary& target) {
+            reference.store(target, abi);
+            if (onScanned)
+                onScanned(target);
+        });
+        return;
+    }
+
+    std::vector<char> found(targets.size(), false);
+    Parallel::forEachIndex(targets.size(), jobs, [&](size_t index) { found[index] = reuse(*targets[index]); });
+    std::vector<SharedLibrary*> missing;
+    for (size_t index = 0; index < targets.size(); ++index)
+    {
+        if (!found[index])
+            missing.push_back(targets[index]);
+        else if (onScanned)
+            onScanned(*targets[index]);
+    }
+    backend->scanBatch(missing, jobs, onScanned);
+}
+
+bool AbiReuseDependencyExtractor::reuse(SharedLibrary& target)
+{
+    Trace::Scope scope("reuse check", target.path);
+    LibraryFile file;
+    if (!file.open(target.path, {}))
+        return false;
+    ElfFile elf(file.bytes());
+    if (!elf.isValid())
+        return false;
+    if (!reference.find(target, abi, hashNeeded(elf.soname(), elf.neededLibraries(), abi)))
+    {
+        ++different;
+        return false;
+    }
+    ++reused;
+    return true;
+}
+
+std::string AbiReuseDependencyExtractor::neutralName(std::string_view name, std::string_view abi)
+{
+    // Only <name>_<abi>.so, x86 must not match inside libfoo_x86_64.so
+    auto suffixLength = 1 + abi.size() + LIBRARY_SUFFIX.size();
+    if (name.size() <= suffixLength || !name.ends_with(LIBRARY_SUFFIX) ||
+        name.substr(name.size() - suffixLength, 1 + abi.size()) != fmt::format("_{}", abi))
+        return std::string(name);
+    return fmt::format("{}_{}{}", name.substr(0, name.size() - suffixLength), ABI_PLACEHOLDER, LIBRARY_SUFFIX);
+}
+
+std::string AbiReuseDependencyExtractor::abiName(std::string_view name, std::string_view abi)
+{
+    auto idx = name.find(ABI_PLACEHOLDER);
+    if (idx == std::string_view::npos)
+        return std::string(name);
+    return fmt::format("{}{}{}", name.substr(0, idx), abi, name.substr(idx + ABI_PLACEHOLDER.size()));
+}
+
+uint64_t AbiReuseDependencyExtractor::neededHash(const SharedLibrary& library, std::string_view abi)
+{
+    std::vector<std::string_view> needed(library.dependencies.cbegin(), library.dependencies.cend());
+    return hashNeeded(library.soname, needed, abi);
+}
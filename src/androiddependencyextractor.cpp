@@ -5,6 +5,7 @@
 #include <spdlog/spdlog.h>
 
 #include "textutils.h"
+#include "trace.h"
 
 
 static std::string findInPath(const std::set<std::string>& directories, const std::string& fileName)
@@ -29,13 +30,16 @@ void AndroidDependencyExtractor::scanDependencies(SharedLibrary& target)
 {
     auto readCmd = fmt::format("{} --needed-libs {}", toolPath, target.path);
 
+    auto spawnStart = Trace::now();
     FILE* readProcess = popen(readCmd.c_str(), "r");
+    Trace::complete("readobj spawn", target.path, spawnStart, Trace::now());
     if (!readProcess)
     {
         spdlog::error("Cannot execute process {}", readCmd);
         return;
     }
 
+    Trace::Scope scope("readobj parse", target.path);
     bool readLibs = false;
     char buffer[1024];
     while (fgets(buffer, sizeof(buffer), readProcess) != nullptr)
@@ -44,6 +48,8 @@ void AndroidDependencyExtractor::scanDependencies(SharedLibrary& target)
         line = Text::trim(line);
         if (!readLibs)
         {
+            if (line.starts_with("LoadName:"))
+                target.soname = Text::trim(line.substr(9));
             readLibs = line.starts_with("NeededLibraries");
             continue;
         }
@@ -55,67 +61,6 @@ void AndroidDependencyExtractor::scanDependencies(SharedLibrary& target)
     pclose(readProcess);
 }
 
-ResolveResult AndroidDependencyExtractor::resolveDependencies(SharedLibrary& target,
-                                                                                     const ExtractorOptions& options)
-{
-    SharedLibrary lib = target;
-    SharedLibraries libsToCopy;
-    SharedLibraries libsToCheck;
-    SharedLibraries checkedLibs;
-    SharedLibraries resolvedLibs;
-    SharedLibraries unmetLibs;
-
-    auto inProgress = [&](const auto& library) {
-        return libsToCheck.contains(library) || resolvedLibs.contains(library) || checkedLibs.contains(library) ||
-               unmetLibs.contains(library);
-    };
-
-    while (!lib.name.empty())
-    {
-        scanDependencies(lib);
-        resolvedLibs.insert({lib.name, lib});
-        for (const auto& library : lib.dependencies)
-            if (!inProgress(library))
-                libsToCheck.insert({library, SharedLibrary{.name = library}});
-        lib = {};
-
-        while (!libsToCheck.empty())
-        {
-            auto dependency = libsToCheck.begin();
-            auto markAsChecked = [&](const std::string& path, bool skipAnalysis = false, bool shouldBeCopied = false) {
-                auto modified = *dependency;
-                modified.second.path = path;
-
-                if (skipAnalysis)
-                    resolvedLibs.insert(modified);
-                else
-                    checkedLibs.insert(modified);
-
-                if (shouldBeCopied)
-                    libsToCopy.insert(modified);
-
-                libsToCheck.erase(libsToCheck.begin());
-            };
-
-            if (options.libraryDirsFiles.contains(dependency->first))
-                markAsChecked(options.libraryDirsFiles.at(dependency->first), false, false);
-            else if (options.scanDirsFiles.contains(dependency->first))
-                markAsChecked(options.scanDirsFiles.at(dependency->first), false, true);
-            else if (options.systemDirsFiles.contains(dependency->first))
-                markAsChecked(options.systemDirsFiles.at(dependency->first), true, false);
-            else
-                unmetLibs.insert(libsToCheck.extract(libsToCheck.begin()));
-        }
-
-        if (!checkedLibs.empty())
-        {
-            lib = checkedLibs.begin()->second;
-            checkedLibs.extract(checkedLibs.begin());
-        }
-    }
-    return {.resolved = resolvedLibs, .availableForCopy = libsToCopy, .unmet = unmetLibs};
-}
-
 std::string AndroidDependencyExtractor::getToolPath(const std::string& ndkPath, const std::string& toolchainPrefix,
                                              const std::string& ndkHost)
 {
@@ -128,3 +73,14 @@ std::string AndroidDependencyExtractor::platformPath(const std::string& ndkPath,
     return fmt::format("{}/toolchains/{}/prebuilt/{}/sysroot/usr/lib/{}/{}", ndkPath, toolchainPrefix, ndkHost, arch,
                        platform);
 }
+
+const std::set<std::string>& AndroidDependencyExtractor::platformLibraries()
+{
+    // Stable NDK system libraries, used when no sysroot is available to list them
+    static const std::set<std::string> libraries{
+        "libaaudio.so", "libamidi.so", "libandroid.so", "libbinder_ndk.so", "libc.so", "libcamera2ndk.so", "libdl.so",
+        "libEGL.so", "libGLESv1_CM.so", "libGLESv2.so", "libGLESv3.so", "libjnigraphics.so", "liblog.so", "libm.so",
+        "libmediandk.so", "libnativewindow.so", "libneuralnetworks.so", "libOpenMAXAL.so", "libOpenSLES.so",
+        "libstdc++.so", "libsync.so", "libvulkan.so", "libz.so"};
+    return libraries;
+}
@@ -0,0 +1,74 @@
+#include "architecturerunner.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/spdlog.h>
+
+namespace {
+class BufferedSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    void replay()
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& message : messages)
+            for (const auto& sink : spdlog::default_logger()->sinks())
+                if (sink->should_log(message.level))
+                    sink->log(message);
+        messages.clear();
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& message) override { messages.emplace_back(message); }
+    void flush_() override {}
+
+private:
+    std::vector<spdlog::details::log_msg_buffer> messages;
+};
+} // namespace
+
+ArchitectureRunner::ArchitectureRunner(Architectures architectures) : archs(std::move(architectures))
+{
+}
+
+bool ArchitectureRunner::run(const Task& task, const std::string& first) const
+{
+    std::vector<std::shared_ptr<BufferedSink>> sinks;
+    for (size_t index = 0; index < archs.size(); ++index)
+        sinks.emplace_back(std::make_shared<BufferedSink>());
+    std::vector<char> results(archs.size(), false);
+    auto start = [&](size_t index) {
+        return std::jthread([&, index]() {
+            spdlog::logger log(archs[index].first, sinks[index]);
+            log.set_level(spdlog::get_level());
+            try
+            {
+                results[index] = task(archs[index].first, archs[index].second, log);
+            }
+            catch (const std::exception& error)
+            {
+                log.error("{}", error.what());
+            }
+        });
+    };
+    for (size_t index = 0; index < archs.size(); ++index)
+        if (archs[index].first == first)
+            start(index).join();
+    {
+        std::vector<std::jthread> workers;
+        for (size_t index = 0; index < archs.size(); ++index)
+            if (archs[index].first != first)
+                workers.push_back(start(index));
+    }
+
+    for (const auto& sink : sinks)
+        sink->replay();
+    spdlog::default_logger()->flush();
+    return std::all_of(results.cbegin(), results.cend(), [](auto result) { return result; });
+}
@@ -0,0 +1,335 @@
+#include "batchreadobjdependencyextractor.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fmt/format.h>
+#include <filesystem>
+#include <list>
+#include <spdlog/spdlog.h>
+#include <unordered_map>
+
+#include "textutils.h"
+#include "trace.h"
+
+extern char** environ;
+
+namespace {
+struct Batch
+{
+    std::vector<SharedLibrary*> targets;
+};
+
+class ReadobjProcess
+{
+public:
+    ReadobjProcess(Batch batch, const DependencyExtractor::ScanCallback& onScanned)
+        : batch(std::move(batch)), onScanned(onScanned)
+    {
+        for (auto target : this->batch.targets)
+            pending[target->path].push_back(target);
+    }
+
+    ReadobjProcess(const ReadobjProcess&) = delete;
+    ReadobjProcess& operator=(const ReadobjProcess&) = delete;
+
+    ~ReadobjProcess()
+    {
+        for (auto fd : {outputFd, errorFd})
+            if (fd >= 0)
+                close(fd);
+        if (pid > 0)
+            waitpid(pid, nullptr, 0);
+    }
+
+    bool start(const std::string& tool)
+    {
+        int output[2];
+        int errors[2];
+        if (pipe2(output, O_CLOEXEC) != 0)
+            return false;
+        if (pipe2(errors, O_CLOEXEC) != 0)
+        {
+            close(output[0]);
+            close(output[1]);
+            return false;
+        }
+
+        std::vector<std::string> arguments{tool, "--needed-libs"};
+        for (auto target : batch.targets)
+            arguments.push_back(target->path);
+        std::vector<char*> argv;
+        for (auto& argument : arguments)
+            argv.push_back(argument.data());
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, errors[1], STDERR_FILENO);
+        auto status = posix_spawn(&pid, tool.c_str(), &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(output[1]);
+        close(errors[1]);
+
+        outputFd = output[0];
+        errorFd = errors[0];
+        if (status != 0)
+        {
+            pid = 0;
+            errno = status;
+            return false;
+        }
+        startTime = Trace::now();
+        fcntl(outputFd, F_SETFL, fcntl(outputFd, F_GETFL) | O_NONBLOCK);
+        fcntl(errorFd, F_SETFL, fcntl(errorFd, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    void addPollDescriptors(std::vector<pollfd>& descriptors) const
+    {
+        for (auto fd : {outputFd, errorFd})
+            if (fd >= 0)
+                descriptors.push_back({.fd = fd, .events = POLLIN, .revents = 0});
+    }
+
+    // Reads whatever is available, closes descriptors at end of stream
+    void readAvailable()
+    {
+        readFrom(outputFd, outputBuffer, [this](const std::string& line) { parseOutputLine(line); });
+        readFrom(errorFd, errorBuffer, [this](const std::string& line) { parseErrorLine(line); });
+    }
+
+    bool finished() const { return outputFd < 0 && errorFd < 0; }
+
+    // Finishes process, returns libraries that were neither reported nor failed
+    std::vector<SharedLibrary*> finish()
+    {
+        completeSection();
+        if (pid > 0)
+            waitpid(pid, nullptr, 0);
+        pid = 0;
+        if (Trace::enabled())
+            Trace::complete("readobj batch", fmt::format("{} files", batch.targets.size()), startTime, Trace::now());
+
+        std::vector<SharedLibrary*> remaining;
+        for (auto target : batch.targets)
+            if (pending.contains(target->path))
+                remaining.push_back(target);
+        return remaining;
+    }
+
+    bool madeProgress() const { return progress; }
+
+    // Batch of process that did not start
+    Batch takeBatch() { return std::move(batch); }
+
+private:
+    template <typename LineHandler>
+    void readFrom(int& fd, std::string& buffer, LineHandler handler)
+    {
+        if (fd < 0)
+            return;
+        char chunk[4096];
+        while (true)
+        {
+            auto count = read(fd, chunk, sizeof(chunk));
+            if (count > 0)
+            {
+                buffer.append(chunk, static_cast<size_t>(count));
+                continue;
+            }
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            // End of stream (or error), flush last incomplete line
+            close(fd);
+            fd = -1;
+            buffer.push_back('\n');
+            break;
+        }
+
+        size_t start = 0;
+        for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', start))
+        {
+            handler(buffer.substr(start, end - start));
+            start = end + 1;
+        }
+        buffer.erase(0, start);
+    }
+
+    void parseOutputLine(const std::string& rawLine)
+    {
+        auto line = Text::trim(rawLine);
+        if (line.starts_with("File:"))
+        {
+            completeSection();
+            auto path = Text::trim(line.substr(5));
+            if (auto it = pending.find(path); it != pending.end())
+            {
+                current = std::move(it->second);
+                pending.erase(it);
+            }
+            return;
+        }
+        if (current.empty())
+            return;
+
+        if (line.starts_with("LoadName:"))
+        {
+            for (auto target : current)
+                target->soname = Text::trim(line.substr(9));
+        }
+        else if (line.starts_with("NeededLibraries"))
+            readLibs = true;
+        else if (line == "]")
+            readLibs = false;
+        else if (readLibs && !line.empty())
+            for (auto target : current)
+                target->dependencies.insert(line);
+    }
+
+    void parseErrorLine(const std::string& line)
+    {
+        // llvm-readobj: error: '<path>': <message>
+        auto begin = line.find('\'');
+        auto end = begin == std::string::npos ? std::string::npos : line.find("':", begin + 1);
+        if (end == std::string::npos)
+        {
+            if (!Text::trim(line).empty())
+                spdlog::error("{}", line);
+            return;
+        }
+
+        auto path = line.substr(begin + 1, end - begin - 1);
+        spdlog::error("Cannot scan {}: {}", path, Text::trim(line.substr(end + 2)));
+        if (auto it = pending.find(path); it != pending.end())
+        {
+            for (auto target : it->second)
+                if (onScanned)
+                    onScanned(*target);
+            pending.erase(it);
+            progress = true;
+        }
+    }
+
+    void completeSection()
+    {
+        for (auto target : current)
+        {
+            target->scanned = true;
+            if (onScanned)
+                onScanned(*target);
+        }
+        if (!current.empty())
+            progress = true;
+        current.clear();
+        readLibs = false;
+    }
+
+    Batch batch;
+    const DependencyExtractor::ScanCallback& onScanned;
+    std::unordered_map<std::string, std::vector<SharedLibrary*>> pending;
+    std::vector<SharedLibrary*> current;
+    bool readLibs = false;
+    bool progress = false;
+    pid_t pid = 0;
+    uint64_t startTime = 0;
+    int outputFd = -1;
+    int errorFd = -1;
+    std::string outputBuffer;
+    std::string errorBuffer;
+};
+} // namespace
+
+BatchReadobjDependencyExtractor::BatchReadobjDependencyExtractor(const std::string& tool, size_t batchSize)
+    : toolPath(tool), batchSize(std::max<size_t>(1, batchSize))
+{
+    if (!std::filesystem::exists(toolPath))
+    {
+        spdlog::error("Command does not exist: {}", toolPath);
+        toolPath.clear();
+    }
+}
+
+void BatchReadobjDependencyExtractor::scanDependencies(SharedLibrary& target)
+{
+    SharedLibrary* targets[] = {&target};
+    scanBatch(targets, 1, {});
+}
+
+void BatchReadobjDependencyExtractor::scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs,
+                                                const ScanCallback& onScanned)
+{
+    if (toolPath.empty())
+        return;
+
+    std::deque<Batch> batches;
+    for (size_t offset = 0; offset < targets.size(); offset += batchSize)
+    {
+        auto count = std::min(batchSize, targets.size() - offset);
+        batches.push_back({.targets = {targets.begin() + offset, targets.begin() + offset + count}});
+    }
+
+    std::list<ReadobjProcess> running;
+    while (!batches.empty() || !running.empty())
+    {
+        while (!batches.empty() && running.size() < std::max(1u, jobs))
+        {
+            auto& process = running.emplace_back(std::move(batches.front()), onScanned);
+            batches.pop_front();
+            if (process.start(toolPath))
+                continue;
+
+            // Remaining batches would fail the same way, running processes are still finished
+            spdlog::error("Cannot execute process {}: {}", toolPath, std::strerror(errno));
+            batches.push_front(process.takeBatch());
+            running.pop_back();
+            for (const auto& batch : batches)
+                for (auto target : batch.targets)
+                    if (onScanned)
+                        onScanned(*target);
+            batches.clear();
+        }
+
+        Trace::counter("readobj processes", static_cast<int64_t>(running.size()));
+        std::vector<pollfd> descriptors;
+        for (const auto& process : running)
+            process.addPollDescriptors(descriptors);
+        if (!descriptors.empty() && poll(descriptors.data(), descriptors.size(), -1) < 0 && errno != EINTR)
+        {
+            spdlog::error("Waiting for {} failed", toolPath);
+            return;
+        }
+
+        for (auto it = running.begin(); it != running.end();)
+        {
+            it->readAvailable();
+            if (!it->finished())
+            {
+                ++it;
+                continue;
+            }
+
+            // llvm-readobj stops at first broken file, retry whatever was left after it
+            auto remaining = it->finish();
+            if (!remaining.empty() && it->madeProgress())
+                batches.push_front({.targets = std::move(remaining)});
+            else
+                for (auto target : remaining)
+                {
+                    spdlog::error("No output from {} for {}", toolPath, target->path);
+                    if (onScanned)
+                        onScanned(*target);
+                }
+            it = running.erase(it);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "buildinputs.h"
+
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+#include "ziparchive.h"
+
+namespace {
+std::string absolutePath(std::string_view path)
+{
+    std::error_code error;
+    auto absolute = std::filesystem::absolute(std::filesystem::path(path), error);
+    return error ? std::string(path) : absolute.lexically_normal().string();
+}
+} // namespace
+
+void BuildInputs::addInput(std::string_view path)
+{
+    if (path.empty())
+        return;
+    auto split = ZipArchive::splitPath(path);
+    auto input = absolutePath(split ? std::string_view(split->first) : path);
+    std::lock_guard lock(mutex);
+    inputs.insert(std::move(input));
+}
+
+void BuildInputs::addOutput(std::string_view path)
+{
+    auto output = absolutePath(path);
+    std::lock_guard lock(mutex);
+    outputs.insert(std::move(output));
+}
+
+bool BuildInputs::write(const std::string& stampPath, const std::string& depfilePath) const
+{
+    std::lock_guard lock(mutex);
+    // Stamp is written last, so it is newer than everything deployed before it
+    if (!depfilePath.empty())
+    {
+        std::ofstream depfile(depfilePath, std::ios::trunc);
+        depfile << escape(absolutePath(stampPath)) << ':';
+        for (const auto& input : inputs)
+            if (std::filesystem::exists(input))
+                depfile << " \\\n  " << escape(input);
+        depfile << '\n';
+        if (!depfile)
+        {
+            spdlog::error("Cannot write depfile {}", depfilePath);
+            return false;
+        }
+    }
+
+    std::ofstream stamp(stampPath, std::ios::trunc);
+    for (const auto& output : outputs)
+        stamp << output << '\n';
+    if (!stamp)
+    {
+        spdlog::error("Cannot write stamp {}", stampPath);
+        return false;
+    }
+    return true;
+}
+
+std::string BuildInputs::escape(std::string_view path)
+{
+    std::string escaped;
+    escaped.reserve(path.size());
+    for (auto character : path)
+    {
+        if (character == ' ' || character == '#')
+            escaped += '\\';
+        else if (character == '$')
+            escaped += '$';
+        escaped += character;
+    }
+    return escaped;
+}
@@ -0,0 +1,43 @@
+#include "cachingdependencyextractor.h"
+
+#include <mutex>
+
+#include "parallel.h"
+#include "trace.h"
+
+CachingDependencyExtractor::CachingDependencyExtractor(std::unique_ptr<DependencyExtractor> backend, ScanCache& cache)
+    : backend(std::move(backend)), cache(cache)
+{
+}
+
+void CachingDependencyExtractor::scanDependencies(SharedLibrary& target)
+{
+    if (cache.lookup(target))
+        return;
+    backend->scanDependencies(target);
+    cache.store(target);
+}
+
+void CachingDependencyExtractor::scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs,
+                                           const ScanCallback& onScanned)
+{
+    std::vector<char> found(targets.size(), false);
+    Parallel::forEachIndex(targets.size(), jobs, [&](size_t index) { found[index] = cache.lookup(*targets[index]); });
+
+    std::vector<SharedLibrary*> missing;
+    for (size_t index = 0; index < targets.size(); ++index)
+    {
+        if (!found[index])
+            missing.push_back(targets[index]);
+        else if (onScanned)
+            onScanned(*targets[index]);
+    }
+
+    backend->scanBatch(missing, jobs, [&](SharedLibrary& target) {
+        cache.store(target);
+        if (onScanned)
+            onScanned(target);
+    });
+    Trace::counter("scan cache hits", static_cast<int64_t>(cache.hits()));
+    Trace::counter("scan cache misses", static_cast<int64_t>(cache.misses()));
+}
@@ -1,4 +1,17 @@
+#include <poll.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <set>
 #include <string>
 #include <string_view>
@@ -6,17 +19,237 @@
 
 #include <filesystem>
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 #include <nlohmann/json.hpp>
+#include <spdlog/sinks/ostream_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include "abireusedependencyextractor.h"
 #include "androiddependencyextractor.h"
+#include "architecturerunner.h"
+#include "batchreadobjdependencyextractor.h"
+#include "buildinputs.h"
+#include "cachingdependencyextractor.h"
+#include "deployer.h"
+#include "elfdependencyextractor.h"
+#include "entrypoints.h"
+#include "filewatcher.h"
+#include "localsocket.h"
+#include "parallel.h"
+#include "qtpluginindex.h"
+#include "startupanalysis.h"
+#include "symbolverifier.h"
+#include "trace.h"
+#include "ziparchive.h"
 
 #include <CLI/CLI.hpp>
 
-std::unordered_map<std::string, std::string> ARCH_MAPPING{{"armeabi-v7a", "arm-linux-androideabi"},
-                                                          {"arm64-v8a", "aarch64-linux-android"},
-                                                          {"x86", "i686-linux-android"},
-                                                          {"x86_64", "x86_64-linux-android"}};
+const Architectures ARCH_MAPPING{{"armeabi-v7a", "arm-linux-androideabi"},
+                                {"arm64-v8a", "aarch64-linux-android"},
+                                {"x86", "i686-linux-android"},
+                                {"x86_64", "x86_64-linux-android"}};
+// Requests of --daemon clients are short, a client is not waited for longer
+constexpr int REQUEST_TIMEOUT_MS = 5000;
+constexpr size_t MAX_REQUEST_LENGTH = 256;
+
+void reportDeploy(const Deployer& deployer)
+{
+    constexpr double MIB = 1024.0 * 1024.0;
+    auto stats = deployer.stats();
+    spdlog::info("Deploy: {} reflinked, {} hardlinked, {} copied, {} unchanged, {} failed; {:.1f} MiB written, "
+                 "{:.1f} MiB avoided",
+                 stats.cloned, stats.linked, stats.copied, stats.unchanged, stats.failed, stats.bytesWritten / MIB,
+                 stats.bytesAvoided / MIB);
+    if (stats.stripped > 0)
+        spdlog::info("Deploy: {} libraries stripped, {:.1f} MiB saved", stats.stripped, stats.bytesStripped / MIB);
+}
+
+const char* tierName(LibraryTier tier)
+{
+    switch (tier)
+    {
+    case LibraryTier::Root:
+        return "root";
+    case LibraryTier::Library:
+        return "library";
+    case LibraryTier::Scan:
+        return "copy";
+    case LibraryTier::System:
+        return "system";
+    default:
+        return "unmet";
+    }
+}
+
+std::string formatCost(const StartupAnalysis::Cost& cost)
+{
+    return fmt::format("{:.1f} KiB, {} relocations, {} PLT relocations, {} symbols, {} initializers",
+                       cost.fileSize / 1024.0, cost.relocations, cost.pltRelocations, cost.symbols,
+                       cost.initFunctions);
+}
+
+nlohmann::json costJson(const StartupAnalysis::Cost& cost)
+{
+    return {{"libraries", cost.libraries},     {"fileSize", cost.fileSize},
+            {"relocations", cost.relocations}, {"pltRelocations", cost.pltRelocations},
+            {"symbols", cost.symbols},         {"initFunctions", cost.initFunctions}};
+}
+
+// Events of --ndjson output, one JSON object per line, written (and flushed) as they happen
+class EventWriter
+{
+public:
+    bool open(const std::string& path)
+    {
+        if (path == "-")
+        {
+            output = &std::cout;
+            return true;
+        }
+        file.open(path, std::ios::trunc);
+        output = &file;
+        return file.good();
+    }
+
+    bool isOpen() const { return output != nullptr; }
+
+    void write(const nlohmann::json& event)
+    {
+        if (!output)
+            return;
+        auto line = event.dump() + '\n';
+        std::lock_guard lock(mutex);
+        *output << line << std::flush;
+    }
+
+private:
+    std::ofstream file;
+    std::ostream* output = nullptr;
+    std::mutex mutex;
+};
+
+// Thin client of --daemon mode, prints output of request
+int requestDaemon(const std::string& socketPath, const std::string& request)
+{
+    auto fd = LocalSocket::connect(socketPath);
+    if (fd < 0)
+    {
+        spdlog::error("Cannot connect to daemon at {}", socketPath);
+        return 1;
+    }
+    bool sent = LocalSocket::sendAll(fd, request + "\n");
+    auto reply = sent ? LocalSocket::receiveAll(fd) : std::string();
+    close(fd);
+    if (!sent)
+    {
+        spdlog::error("Cannot send request to daemon at {}", socketPath);
+        return 1;
+    }
+    fmt::print("{}", reply);
+    return 0;
+}
+
+// Serves check and deploy requests until shutdown request. Scan results and
+// directory listings stay in caches between requests, files reported by
+// watcher are dropped from them, so only changed files are scanned again.
+// Output of check is reused as long as nothing changed.
+int serveRequests(const std::string& socketPath, const std::set<std::string>& directories, ScanCache& cache,
+                  DirectoryCache& directoryCache, const std::function<bool(bool deploy)>& check)
+{
+    FileWatcher watcher;
+    bool watchingAll = watcher.isValid();
+    for (const auto& directory : directories)
+        watchingAll = watcher.watch(directory) && watchingAll;
+    if (!watchingAll)
+        spdlog::warn("Not all directories are watched, every request runs full check");
+
+    auto listenFd = LocalSocket::listen(socketPath);
+    if (listenFd < 0)
+        return 1;
+    spdlog::info("Listening on {}", socketPath);
+
+    std::optional<std::string> lastCheck;
+    auto applyChanges = [&]() {
+        auto changes = watcher.readChanges();
+        if (changes.empty())
+            return;
+        for (const auto& path : changes.files)
+            cache.invalidate(path);
+        for (const auto& directory : changes.directories)
+            directoryCache.invalidate(directory);
+        if (changes.lost)
+            spdlog::warn("Some file changes were lost, relying on file size and mtime");
+        lastCheck.reset();
+    };
+    // Output of all loggers is captured for reply, loggers are written by several threads
+    auto runCaptured = [&](bool deploy) {
+        std::ostringstream output;
+        auto& sinks = spdlog::default_logger()->sinks();
+        sinks.push_back(std::make_shared<spdlog::sinks::ostream_sink_mt>(output));
+        check(deploy);
+        spdlog::default_logger()->flush();
+        sinks.pop_back();
+        return output.str();
+    };
+
+    bool running = true;
+    while (running)
+    {
+        std::array<pollfd, 2> descriptors{{{.fd = listenFd, .events = POLLIN, .revents = 0},
+                                           {.fd = watcher.descriptor(), .events = POLLIN, .revents = 0}}};
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            spdlog::error("Cannot wait for requests: {}", std::strerror(errno));
+            break;
+        }
+        if (!(descriptors[0].revents & POLLIN))
+        {
+            applyChanges();
+            continue;
+        }
+
+        auto client = LocalSocket::accept(listenFd);
+        if (client < 0)
+            continue;
+        // Client that does not send its request in time is dropped, it would block everyone else
+        auto request = LocalSocket::receiveLine(client, REQUEST_TIMEOUT_MS, MAX_REQUEST_LENGTH);
+        if (!request)
+        {
+            close(client);
+            continue;
+        }
+        // Changes made just before request (e.g. by build that called client) are already queued
+        applyChanges();
+        std::string reply;
+        if (*request == "check")
+        {
+            if (!lastCheck || !watchingAll)
+                lastCheck = runCaptured(false);
+            reply = *lastCheck;
+        }
+        else if (*request == "deploy")
+        {
+            reply = runCaptured(true);
+        }
+        else if (*request == "shutdown")
+        {
+            reply = "Daemon stopped\n";
+            running = false;
+        }
+        else
+        {
+            reply = fmt::format("Unknown request '{}', expected check, deploy or shutdown\n", *request);
+        }
+        LocalSocket::sendAll(client, reply);
+        close(client);
+    }
+    close(listenFd);
+    unlink(socketPath.c_str());
+    return 0;
+}
 
 int main(int argc, char* argv[])
 {
@@ -26,12 +259,37 @@ int main(int argc, char* argv[])
     std::string appName;
     std::string ndkPath;
     std::string jsonFile;
+    std::string manifestFile;
     std::string toolchainPrefix = "llvm";
     std::string ndkHost = "linux-x86_64";
+    std::string backend = "elf";
+    unsigned jobs = Parallel::defaultJobs();
+    std::string cacheFile;
+    bool cacheByContent = false;
+    std::string traceFile;
+    bool printStats = false;
+    std::string logLevel = "debug";
+    std::string daemonSocket;
+    std::string clientSocket;
+    bool stopDaemon = false;
     std::set<std::string> extraDirs;
     std::set<std::string> libDirs;
     int platform = 0;
     bool fixLibs = false;
+    bool deployHardlinks = false;
+    bool deployStrip = false;
+    std::string stripCacheDir;
+    bool withPlugins = false;
+    bool verifySymbols = false;
+    bool failFast = false;
+    bool startupReport = false;
+    bool unusedDependencies = false;
+    std::string eventsFile;
+    std::string archiveFile;
+    std::string pluginIndexFile;
+    std::string referenceAbi;
+    std::string depfile;
+    std::string stampFile;
     std::string qt;
     app.add_option("-d,--directory", appDirectory, "Build directory with subdirs (armeabi/arm64...)")
         ->check(CLI::ExistingDirectory);
@@ -39,17 +297,71 @@ int main(int argc, char* argv[])
     app.add_option("-n,--ndk", ndkPath, "Android NDK")->check(CLI::ExistingDirectory);
     app.add_option("-p,--platform", platform, "Android target platform")->check(CLI::PositiveNumber);
     app.add_option("-q,--qt", qt, "Qt install directory")->check(CLI::ExistingDirectory);
+    app.add_option("--archive", archiveFile, "Check native libraries inside APK or AAB instead of build directory")
+        ->check(CLI::ExistingFile);
     app.add_option("-j,--json", jsonFile, "JSON with configuration")->check(CLI::ExistingFile);
+    app.add_option("-m,--manifest", manifestFile, "JSON with more applications/libraries checked in one pass")
+        ->check(CLI::ExistingFile);
     app.add_option("-e,--extradirs", extraDirs, "Extra dirs (, separated)use during app libs load")
         ->check(CLI::ExistingDirectory);
     app.add_option("-l,--libdirs", libDirs, "Directories where missing libs might be found (, separated)")
         ->check(CLI::ExistingDirectory);
     app.add_flag("-f,--fix", fixLibs, "Try to fix missing libs");
     app.add_option("-c,--deploy", deployDir, "Where to deploy missing libs")->check(CLI::ExistingDirectory);
+    app.add_flag("--deploy-hardlinks", deployHardlinks,
+                 "Deploy libraries as hardlinks when possible (deployed files then share content with originals)");
+    app.add_flag("--deploy-strip", deployStrip, "Deploy libraries without debug info and symbol tables");
+    app.add_option("--strip-cache", stripCacheDir,
+                   "Directory with stripped libraries reused between runs (default: next to --cache or in temp)");
+    app.add_option("-b,--backend", backend,
+                   "Library scanner: elf (built-in), readobj (NDK llvm-readobj) or readobj-batch (many files per "
+                   "llvm-readobj process)")
+        ->check(CLI::IsMember({"elf", "readobj", "readobj-batch"}));
+    app.add_option("--jobs", jobs, "Number of libraries scanned in parallel")->check(CLI::PositiveNumber);
+    std::vector<std::string> abis;
+    for (const auto& arch : ARCH_MAPPING)
+        abis.push_back(arch.first);
+    app.add_option("--reference-abi", referenceAbi,
+                   "Resolve this architecture first, others reuse its scan results for libraries with the same "
+                   "needed libraries")
+        ->check(CLI::IsMember(abis));
+    app.add_option("--cache", cacheFile, "File with scan results reused between runs");
+    app.add_flag("--cache-hash", cacheByContent, "Validate cached scan results by content hash instead of mtime");
+    app.add_option("--trace", traceFile, "Write timings of all phases as Chrome trace-event JSON");
+    app.add_flag("--stats", printStats, "Print summary of timings and counters");
+    app.add_option("--log-level", logLevel, "Log level: trace, debug, info, warn, error or off")
+        ->check(CLI::IsMember({"trace", "debug", "info", "warn", "error", "off"}));
+    app.add_flag("--plugins", withPlugins,
+                 "Resolve (and deploy) Qt plugins of used Qt modules together with their dependencies");
+    app.add_option("--plugin-index", pluginIndexFile,
+                   "File with index of Qt plugins, built on first use and rebuilt when Qt installation changes");
+    app.add_flag("--verify-symbols", verifySymbols,
+                 "Check that undefined symbols of every library are exported by its dependencies");
+    app.add_flag("--startup-report", startupReport,
+                 "Report load order and load cost (size, relocations, symbols, initializers) of every application");
+    app.add_flag("--unused-deps", unusedDependencies,
+                 "Report DT_NEEDED entries providing no imported symbol and what dropping them would save");
+    app.add_flag("--fail-fast", failFast, "Stop checking all architectures at first missing library");
+    app.add_option("--ndjson", eventsFile,
+                   "Write libraries as they are classified and deployed as newline delimited JSON (- for stdout)");
+    app.add_option("--stamp", stampFile,
+                   "Write file listing deployed libraries after successful check (output of build step)");
+    app.add_option("--depfile", depfile,
+                   "With --stamp, write Make/Ninja depfile with every file and directory the check read");
+    app.add_option("--daemon", daemonSocket,
+                   "Keep running, watch library directories and answer requests on this Unix socket");
+    app.add_option("--client", clientSocket,
+                   "Ask daemon listening on this socket for check (or deploy with -f) instead of running it");
+    app.add_flag("--shutdown", stopDaemon, "With --client, stop the daemon");
     CLI11_PARSE(app, argc, argv);
 
+    if (!clientSocket.empty())
+        return requestDaemon(clientSocket, stopDaemon ? "shutdown" : fixLibs ? "deploy" : "check");
+
+    Trace::setEnabled(!traceFile.empty() || printStats);
     if (std::filesystem::exists(jsonFile))
     {
+        Trace::Scope scope("config load", jsonFile);
         using json = nlohmann::json;
         std::ifstream file(jsonFile);
         json data = json::parse(file);
@@ -71,55 +383,517 @@ int main(int argc, char* argv[])
             qt = data["qt"].get<std::string>();
     }
 
-    spdlog::set_level(spdlog::level::debug);
-    bool checkStatus = true;
+    EntryPoints entries;
+    if (!entries.load(appName, manifestFile))
+        return 1;
 
-    for (const auto& arch : ARCH_MAPPING)
+    if (backend.starts_with("readobj") && ndkPath.empty())
+    {
+        spdlog::error("Backend readobj requires NDK path");
+        return 1;
+    }
+    // Reuse reads the same dynamic section ELF backend would, it would only make other architectures wait
+    if (!referenceAbi.empty() && !backend.starts_with("readobj"))
     {
-        auto appDir = fmt::format("{}/{}", appDirectory, arch.first);
-        auto appPath = fmt::format("{}/lib{}_{}.so", appDir, appName, arch.first);
-        auto qtLibDir = fmt::format("{}/lib", qt);
-        if (!std::filesystem::exists(appPath))
+        spdlog::warn("--reference-abi is used only with readobj backends, ignored");
+        referenceAbi.clear();
+    }
+
+    // Libraries of release artifact are read in place, nothing is deployed into it
+    std::shared_ptr<ZipArchive> archive;
+    std::string archiveLibs = "lib";
+    if (!archiveFile.empty())
+    {
+        if (backend != "elf" || fixLibs || !daemonSocket.empty())
         {
-            spdlog::warn("Skipping arch {}, file {} does not exists", arch.first, appPath);
-            continue;
+            spdlog::error("--archive works only with elf backend, without --fix and --daemon");
+            return 1;
         }
+        archive = std::make_shared<ZipArchive>();
+        if (!archive->open(archiveFile))
+        {
+            spdlog::error("Cannot read archive {}: {}", archiveFile, archive->errorString());
+            return 1;
+        }
+        // App bundle keeps libraries of base module in base/lib
+        if (archive->find("BundleConfig.pb"))
+            archiveLibs = "base/lib";
+    }
 
-        SharedLibrary appMainLib{.name = appName, .path = appPath};
-        AndroidDependencyExtractor extractor(
-            AndroidDependencyExtractor::getToolPath(ndkPath, toolchainPrefix, ndkHost));
-        auto platformPath =
-            AndroidDependencyExtractor::platformPath(ndkPath, toolchainPrefix, ndkHost, arch.second, platform);
-        ExtractorOptions options{.libraryDirs = {appDir}, .scanDirs = {qtLibDir}, .systemDirs = {platformPath}};
-        options.preloadInfo(".so");
+    if (!eventsFile.empty() && !daemonSocket.empty())
+    {
+        spdlog::error("--ndjson cannot be used with --daemon");
+        return 1;
+    }
+
+    if ((!depfile.empty() && stampFile.empty()) || (!stampFile.empty() && !daemonSocket.empty()))
+    {
+        spdlog::error("--depfile requires --stamp, neither can be used with --daemon");
+        return 1;
+    }
+    BuildInputs buildInputs;
+    for (const auto& path : {jsonFile, manifestFile, archiveFile, appDirectory})
+        buildInputs.addInput(path);
+
+    EventWriter events;
+    if (!eventsFile.empty() && !events.open(eventsFile))
+    {
+        spdlog::error("Cannot open {}", eventsFile);
+        return 1;
+    }
+    // Standard output is left for events
+    if (eventsFile == "-")
+        spdlog::set_default_logger(
+            std::make_shared<spdlog::logger>("", std::make_shared<spdlog::sinks::stderr_color_sink_mt>()));
+    spdlog::set_level(spdlog::level::from_str(logLevel));
+
+    if (ndkPath.empty())
+        spdlog::info("No NDK given, using built-in list of platform libraries");
+    else
+        for (const auto& arch : ARCH_MAPPING)
+            if (auto platformPath =
+                    AndroidDependencyExtractor::platformPath(ndkPath, toolchainPrefix, ndkHost, arch.second, platform);
+                !std::filesystem::exists(platformPath))
+            {
+                spdlog::error("Directory {} does not exist", platformPath);
+                return 1;
+            }
 
-        if (!std::filesystem::exists(platformPath))
+    if (deployStrip)
+    {
+        if (stripCacheDir.empty() && !cacheFile.empty())
+            stripCacheDir = cacheFile + ".stripped";
+        else if (stripCacheDir.empty())
+            stripCacheDir = std::filesystem::temp_directory_path() / "qtandroiddependencyscanner-stripped";
+        std::error_code error;
+        std::filesystem::create_directories(stripCacheDir, error);
+        if (error)
         {
-            spdlog::error("Directory {} does not exist", platformPath);
+            spdlog::error("Cannot create strip cache {}: {}", stripCacheDir, error.message());
+            return 1;
+        }
+    }
+    auto configureDeployer = [&](Deployer& deployer) {
+        if (deployStrip)
+            deployer.enableStripping(stripCacheDir);
+    };
+
+    // Architectures are checked at the same time, so split workers between them
+    auto archJobs = std::max(1u, jobs / static_cast<unsigned>(ARCH_MAPPING.size()));
+
+    std::unique_ptr<ScanCache> cache;
+    std::unique_ptr<DirectoryCache> directoryCache;
+    if (!cacheFile.empty())
+    {
+        directoryCache = std::make_unique<DirectoryCache>(cacheFile + ".dirs");
+        if (!directoryCache->load())
+            return 1;
+        cache = std::make_unique<ScanCache>(cacheFile, cacheByContent ? ScanCache::Validation::ContentHash
+                                                                       : ScanCache::Validation::FileIdentity);
+        if (!cache->load())
             return 1;
+    }
+    else if (!daemonSocket.empty())
+    {
+        // Daemon keeps scan results in memory only
+        directoryCache = std::make_unique<DirectoryCache>(std::string());
+        cache = std::make_unique<ScanCache>(std::string(), cacheByContent ? ScanCache::Validation::ContentHash
+                                                                           : ScanCache::Validation::FileIdentity);
+    }
+
+    auto architectureOptions = [&](const std::string& abi, const std::string& triple) {
+        ExtractorOptions options{.libraryDirs = {fmt::format("{}/{}", appDirectory, abi)},
+                                 .scanDirs = {fmt::format("{}/lib", qt)}};
+        // Artifact has to contain everything, libraries available only in Qt are missing
+        if (archive)
+            options = {.archiveDirs = {{archive, fmt::format("{}/{}", archiveLibs, abi)}}};
+        if (ndkPath.empty())
+            options.systemLibraries = AndroidDependencyExtractor::platformLibraries();
+        else
+            options.systemDirs = {
+                AndroidDependencyExtractor::platformPath(ndkPath, toolchainPrefix, ndkHost, triple, platform)};
+        options.jobs = archJobs;
+        options.directoryCache = directoryCache.get();
+        return options;
+    };
+
+    QtPluginIndex pluginIndex(qt);
+    if (withPlugins && pluginIndexFile.empty())
+        pluginIndex.build(jobs);
+    else if (withPlugins)
+        pluginIndex.open(pluginIndexFile, jobs);
+    if (!stampFile.empty())
+        for (const auto& path : pluginIndex.metadataFiles())
+            buildInputs.addInput(path);
+
+    // Created for every check, so daemon does not reuse results of previous one
+    std::unique_ptr<AbiReuseDependencyExtractor::Reference> reference;
+
+    // Set by --fail-fast at first missing library, stops all architectures
+    std::atomic<bool> cancelled = false;
+    // Reported separately, a library that cannot be deployed is not missing
+    std::atomic<bool> checkFailed = false;
+    std::atomic<bool> deployFailed = false;
+    auto checkArchitecture = [&](const std::string& abi, const std::string& triple, spdlog::logger& log,
+                                 Deployer* deployer) {
+        auto appDir = fmt::format("{}/{}", appDirectory, abi);
+        // Architecture skipped now is checked once its libraries are built
+        buildInputs.addInput(appDir);
+        std::vector<SharedLibrary> entryPoints;
+        for (const auto& name : entries.applications())
+        {
+            auto appPath = fmt::format("{}/lib{}_{}.so", appDir, name, abi);
+            bool exists = std::filesystem::exists(appPath);
+            if (archive)
+            {
+                auto entry = fmt::format("{}/{}/lib{}_{}.so", archiveLibs, abi, name, abi);
+                appPath = ZipArchive::entryPath(archiveFile, entry);
+                exists = archive->find(entry) != nullptr;
+            }
+            if (!exists)
+            {
+                log.warn("Skipping {} for arch {}, file {} does not exists", name, abi, appPath);
+                continue;
+            }
+            entryPoints.push_back({.name = name, .path = appPath});
+        }
+        auto libraries = entries.librariesOf(abi, log);
+        entryPoints.insert(entryPoints.end(), libraries.begin(), libraries.end());
+        if (entryPoints.empty())
+        {
+            log.warn("Skipping arch {}, nothing to check", abi);
+            return true;
         }
 
-        spdlog::info("Checking dependencies for architecture {}", arch.first);
-        auto result = extractor.resolveDependencies(appMainLib, options);
-        if (!result.unmet.empty())
+        std::unique_ptr<DependencyExtractor> extractor;
+        if (backend == "readobj")
+            extractor = std::make_unique<AndroidDependencyExtractor>(
+                AndroidDependencyExtractor::getToolPath(ndkPath, toolchainPrefix, ndkHost));
+        else if (backend == "readobj-batch")
+            extractor = std::make_unique<BatchReadobjDependencyExtractor>(
+                AndroidDependencyExtractor::getToolPath(ndkPath, toolchainPrefix, ndkHost));
+        else
         {
-            checkStatus = false;
-            break;
+            auto elfExtractor = std::make_unique<ElfDependencyExtractor>();
+            if (archive)
+                elfExtractor->addArchive(archive);
+            extractor = std::move(elfExtractor);
+        }
+        // Reference architecture records everything it gets (cache hits too), others compare with it before cache
+        AbiReuseDependencyExtractor* reuse = nullptr;
+        if (reference && abi != referenceAbi)
+        {
+            auto reuseExtractor =
+                std::make_unique<AbiReuseDependencyExtractor>(std::move(extractor), *reference, abi, false);
+            reuse = reuseExtractor.get();
+            extractor = std::move(reuseExtractor);
         }
+        if (cache)
+            extractor = std::make_unique<CachingDependencyExtractor>(std::move(extractor), *cache);
+        if (reference && abi == referenceAbi)
+            extractor = std::make_unique<AbiReuseDependencyExtractor>(std::move(extractor), *reference, abi, true);
 
-        if (fixLibs && !result.availableForCopy.empty())
+        auto options = architectureOptions(abi, triple);
+        options.preloadInfo(".so");
+
+        // Plugins of every Qt module found are resolved in the same pass as additional entry points
+        DependencyExtractor::RootExpansion expandPlugins;
+        if (withPlugins)
+            expandPlugins = [&](const LibraryView& library) {
+                std::vector<SharedLibrary> plugins;
+                if (!library.name().starts_with("libQt5"))
+                    return plugins;
+                for (const auto& plugin : pluginIndex.plugins(QtPluginIndex::moduleName(std::string(library.name()))))
+                {
+                    auto path = pluginIndex.pluginPath(plugin, abi);
+                    if (path.empty())
+                        continue;
+                    // Plugin that is added later has to trigger the check too
+                    buildInputs.addInput(std::filesystem::path(path).parent_path().string());
+                    if (!std::filesystem::exists(path))
+                        continue;
+                    log.debug("Plugin {} of {}", path, library.name());
+                    plugins.push_back({.name = std::filesystem::path(path).filename(), .path = path});
+                }
+                return plugins;
+            };
+
+        // Libraries are deployed while the rest of graph is still resolved
+        std::optional<DeployQueue> deployQueue;
+        if (deployer)
         {
             auto deployTo = deployDir.empty() ? appDir : deployDir;
-            for (const auto& lib : result.availableForCopy)
+            deployQueue.emplace(*deployer, deployTo, archJobs,
+                                [&, deployTo](const std::string& source, Deployer::Method method) {
+                                    log.debug("Copy {} -> {}", source, deployTo);
+                                    if (method != Deployer::Method::Failed)
+                                        buildInputs.addOutput(fmt::format(
+                                            "{}/{}", deployTo, std::filesystem::path(source).filename().string()));
+                                    events.write({{"abi", abi},
+                                                  {"event", "deployed"},
+                                                  {"path", source},
+                                                  {"status", method != Deployer::Method::Failed}});
+                                });
+        }
+        auto onClassified = [&](const LibraryView& library, const LibraryView* requiredBy) {
+            if (events.isOpen())
+                events.write({{"abi", abi},
+                              {"event", "library"},
+                              {"name", library.name()},
+                              {"path", library.path()},
+                              {"tier", tierName(library.tier())},
+                              {"requiredBy", requiredBy ? nlohmann::json(requiredBy->name()) : nlohmann::json()}});
+            // Roots added by expansion (plugins) are deployed too
+            bool toCopy = library.tier() == LibraryTier::Scan || (library.tier() == LibraryTier::Root && requiredBy);
+            if (deployQueue && toCopy)
+                deployQueue->add(std::string(library.path()));
+            if (failFast && library.tier() == LibraryTier::Unmet)
+                cancelled = true;
+            return !cancelled;
+        };
+
+        log.info("Checking dependencies for architecture {}", abi);
+        auto results = extractor->resolveBatch(entryPoints, options, expandPlugins, onClassified);
+        if (reuse)
+            log.info("Reused {} scan results of {}, {} libraries differ", reuse->reusedCount(), referenceAbi,
+                     reuse->differentCount());
+        bool status = true;
+        for (const auto& result : results)
+        {
+            auto name = result.graph->name(result.root);
+            log.debug("{}: {} resolved, {} available for copy, {} missing", name, result.resolved.size(),
+                      result.availableForCopy.size(), result.unmet.size());
+            for (const auto& lib : result.unmet)
+                log.error("Missing library {} required by {}", lib.name(), name);
+            status = status && result.unmet.empty();
+        }
+        if (!stampFile.empty())
+        {
+            const auto& graph = *results.front().graph;
+            for (LibraryId id = 0; id < graph.size(); ++id)
+                buildInputs.addInput(graph.path(id));
+            for (const auto* paths : {&options.libraryDirs, &options.scanDirs, &options.systemDirs})
+                for (const auto& path : *paths)
+                    buildInputs.addInput(path);
+        }
+        if (cancelled)
+        {
+            log.warn("Check of architecture {} cancelled", abi);
+            if (deployQueue)
+                deployQueue->cancel();
+            checkFailed = true;
+            return false;
+        }
+
+        if (verifySymbols)
+        {
+            std::set<LibraryId> libraries;
+            for (const auto& result : results)
+                libraries.insert(result.resolved.ids().cbegin(), result.resolved.ids().cend());
+            const auto& graph = *results.front().graph;
+            SymbolVerifier verifier;
+            if (archive)
+                verifier.addArchive(archive);
+            std::vector<LibraryId> verified(libraries.cbegin(), libraries.cend());
+            for (const auto& entry : verifier.verify(graph, verified, archJobs))
+            {
+                log.error("Unresolved symbols in {}: {}", graph.name(entry.library), fmt::join(entry.symbols, ", "));
+                status = false;
+            }
+            log.debug("Symbols of {} libraries verified, {} skipped (depend on libraries that cannot be read)",
+                      verifier.verifiedCount(), verifier.skippedCount());
+        }
+        if (unusedDependencies)
+        {
+            const auto& graph = *results.front().graph;
+            std::set<LibraryId> libraries;
+            std::vector<LibraryId> roots;
+            for (const auto& result : results)
+            {
+                libraries.insert(result.resolved.ids().cbegin(), result.resolved.ids().cend());
+                roots.push_back(result.root);
+            }
+            SymbolVerifier verifier;
+            if (archive)
+                verifier.addArchive(archive);
+            std::vector<LibraryId> checked(libraries.cbegin(), libraries.cend());
+            auto unused = verifier.findUnusedDependencies(graph, checked, archJobs);
+            for (const auto& edge : unused)
+            {
+                log.warn("{} needs {} but uses none of its symbols", graph.name(edge.library),
+                         graph.name(edge.dependency));
+                events.write({{"abi", abi},
+                              {"event", "unused"},
+                              {"name", graph.name(edge.library)},
+                              {"dependency", graph.name(edge.dependency)}});
+            }
+
+            size_t notLoaded = 0;
+            size_t notDeployed = 0;
+            uint64_t bytesNotDeployed = 0;
+            for (auto id : SymbolVerifier::droppedLibraries(graph, roots, unused))
             {
-                spdlog::debug("Copy {} -> {}", lib.second.path, deployTo);
-                std::filesystem::copy(lib.second.path, deployTo);
+                if (graph.tier(id) == LibraryTier::System)
+                    continue;
+                ++notLoaded;
+                if (graph.tier(id) != LibraryTier::Scan)
+                    continue;
+                std::error_code error;
+                auto size = std::filesystem::file_size(std::string(graph.path(id)), error);
+                ++notDeployed;
+                bytesNotDeployed += error ? 0 : size;
             }
+            if (!unused.empty())
+                log.info("Without {} unused dependencies {} libraries would not be loaded and {} libraries "
+                         "({:.1f} KiB) would not be deployed",
+                         unused.size(), notLoaded, notDeployed, bytesNotDeployed / 1024.0);
+            events.write({{"abi", abi},
+                          {"event", "prune"},
+                          {"unused", unused.size()},
+                          {"notLoaded", notLoaded},
+                          {"notDeployed", notDeployed},
+                          {"bytesNotDeployed", bytesNotDeployed}});
         }
+        if (startupReport)
+        {
+            const auto& graph = *results.front().graph;
+            std::vector<LibraryId> roots;
+            for (size_t index = 0; index < entryPoints.size(); ++index)
+                roots.push_back(results[index].root);
+            StartupAnalysis analysis;
+            if (archive)
+                analysis.addArchive(archive);
+            for (const auto& report : analysis.analyze(graph, roots, archJobs))
+            {
+                log.info("Startup of {}: {} libraries, {}", graph.name(report.root), report.total.libraries,
+                         formatCost(report.total));
+                auto loadOrder = nlohmann::json::array();
+                for (size_t position = 0; position < report.loadOrder.size(); ++position)
+                {
+                    const auto& library = report.loadOrder[position];
+                    auto name = graph.name(library.library);
+                    if (library.readable)
+                        log.info("  {:>3}. {}: {}", position + 1, name, formatCost(library.cost));
+                    else
+                        log.info("  {:>3}. {}: cannot be read", position + 1, name);
+                    auto entry = costJson(library.cost);
+                    entry["name"] = name;
+                    loadOrder.push_back(std::move(entry));
+                }
+                auto dependencies = nlohmann::json::array();
+                for (const auto& dependency : report.dependencies)
+                {
+                    auto name = graph.name(dependency.dependency);
+                    log.info("  through {}: {} libraries, {}; only through it: {} libraries, {}", name,
+                             dependency.total.libraries, formatCost(dependency.total), dependency.exclusive.libraries,
+                             formatCost(dependency.exclusive));
+                    dependencies.push_back({{"name", name},
+                                            {"total", costJson(dependency.total)},
+                                            {"exclusive", costJson(dependency.exclusive)}});
+                }
+                events.write({{"abi", abi},
+                              {"event", "startup"},
+                              {"name", graph.name(report.root)},
+                              {"total", costJson(report.total)},
+                              {"loadOrder", std::move(loadOrder)},
+                              {"dependencies", std::move(dependencies)}});
+            }
+        }
+        if (!status)
+            checkFailed = true;
+        if (deployQueue && !deployQueue->finish())
+        {
+            log.error("Deploy of architecture {} failed for at least one library", abi);
+            deployFailed = true;
+            status = false;
+        }
+        return status;
+    };
+
+    auto reportFailure = [&]() {
+        if (checkFailed)
+            spdlog::error("Check failed, missing at least one library!");
+        if (deployFailed)
+            spdlog::error("Deploy failed, at least one library was not deployed!");
+    };
+
+    ArchitectureRunner runner(ARCH_MAPPING);
+    bool checkStatus = true;
+    if (!daemonSocket.empty())
+    {
+        std::set<std::string> directories;
+        for (const auto& [abi, triple] : ARCH_MAPPING)
+        {
+            auto options = architectureOptions(abi, triple);
+            for (const auto* paths : {&options.libraryDirs, &options.scanDirs, &options.systemDirs})
+                directories.insert(paths->begin(), paths->end());
+            for (const auto& pattern : entries.libraryPatterns())
+                directories.insert(std::filesystem::path(EntryPoints::libraryPath(pattern, abi)).parent_path());
+        }
+        auto check = [&](bool deploy) {
+            Deployer deployer(deployHardlinks);
+            configureDeployer(deployer);
+            cancelled = false;
+            checkFailed = false;
+            deployFailed = false;
+            if (!referenceAbi.empty())
+                reference = std::make_unique<AbiReuseDependencyExtractor::Reference>();
+            bool status = runner.run(
+                [&](const std::string& abi, const std::string& triple, spdlog::logger& log) {
+                    return checkArchitecture(abi, triple, log, deploy ? &deployer : nullptr);
+                },
+                referenceAbi);
+            if (deploy)
+                reportDeploy(deployer);
+            if (!status)
+                reportFailure();
+            return status;
+        };
+        if (serveRequests(daemonSocket, directories, *cache, *directoryCache, check) != 0)
+            return 1;
+    }
+    else
+    {
+        Deployer deployer(deployHardlinks);
+        configureDeployer(deployer);
+        if (!referenceAbi.empty())
+            reference = std::make_unique<AbiReuseDependencyExtractor::Reference>();
+        checkStatus = runner.run(
+            [&](const std::string& abi, const std::string& triple, spdlog::logger& log) {
+                auto status = checkArchitecture(abi, triple, log, fixLibs ? &deployer : nullptr);
+                events.write({{"abi", abi}, {"event", "done"}, {"status", status}});
+                return status;
+            },
+            referenceAbi);
+        if (fixLibs)
+            reportDeploy(deployer);
+    }
+
+    if (!cacheFile.empty())
+    {
+        spdlog::info("Scan cache: {} hits, {} misses, directory listings: {} reused, {} read", cache->hits(),
+                     cache->misses(), directoryCache->hits(), directoryCache->misses());
+        Trace::Scope scope("scan cache save");
+        cache->save();
+        directoryCache->save();
     }
 
+    if (!traceFile.empty())
+        Trace::writeChromeTrace(traceFile);
+    if (printStats)
+        fmt::print("{}", Trace::summary());
+
     if (!checkStatus)
-        spdlog::error("Check failed, missing at least one library!");
+        reportFailure();
+
+    // Without stamp build step is not up to date, so failed check runs again
+    if (!stampFile.empty() && checkStatus && !buildInputs.write(stampFile, depfile))
+        return 1;
+    if (!stampFile.empty() && !checkStatus)
+    {
+        std::error_code error;
+        std::filesystem::remove(stampFile, error);
+    }
 
     return 0;
 }
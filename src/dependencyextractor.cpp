@@ -1,30 +1,175 @@
 #include "dependencyextractor.h"
 
-#include <filesystem>
-#include <fmt/format.h>
+#include <algorithm>
+#include <mutex>
+#include <optional>
+
+#include "parallel.h"
+#include "trace.h"
 
 void ExtractorOptions::preloadInfo(const std::string& libraryExtension)
 {
-    libraryDirsFiles = scanDirectories(libraryDirs, libraryExtension);
-    scanDirsFiles = scanDirectories(scanDirs, libraryExtension);
-    systemDirsFiles = scanDirectories(systemDirs, libraryExtension);
+    Trace::Scope scope("preloadInfo");
+    // Order of directories gives lookup precedence
+    std::vector<DirectoryIndex::Directory> directories;
+    for (const auto& [tier, paths] : {std::pair{LibraryTier::Library, &libraryDirs},
+                                      std::pair{LibraryTier::Scan, &scanDirs},
+                                      std::pair{LibraryTier::System, &systemDirs}})
+        for (const auto& path : *paths)
+            directories.push_back({.tier = tier, .path = path});
+
+    libraries = {};
+    for (const auto& [archive, directory] : archiveDirs)
+        libraries.addArchiveDirectory(LibraryTier::Library, *archive, directory, libraryExtension);
+    libraries.addDirectories(directories, libraryExtension, jobs, directoryCache);
+    libraries.addLibraries(LibraryTier::System, systemLibraries);
 }
 
-std::vector<std::string> ExtractorOptions::scanDirectory(const std::string& path, const std::string& libraryExtension)
+void DependencyExtractor::scanBatch(std::span<SharedLibrary* const> targets, unsigned jobs,
+                                    const ScanCallback& onScanned)
 {
-    std::vector<std::string> ret;
-    for (const auto& item : std::filesystem::directory_iterator(path))
-        if (item.path().extension() == libraryExtension)
-            ret.push_back(item.path().filename());
-    return ret;
+    std::mutex callbackMutex;
+    Parallel::forEachIndex(targets.size(), jobs, [&](size_t index) {
+        scanDependencies(*targets[index]);
+        if (!onScanned)
+            return;
+        std::lock_guard lock(callbackMutex);
+        onScanned(*targets[index]);
+    });
 }
 
-std::unordered_map<std::string, std::string> ExtractorOptions::scanDirectories(const std::set<std::string>& paths,
-                                                                               const std::string& libraryExtension)
+ResolveResult DependencyExtractor::resolveDependencies(SharedLibrary& target, const ExtractorOptions& options)
 {
-    std::unordered_map<std::string, std::string> ret;
-    for (const auto& path : paths)
-        for (const auto& name : scanDirectory(path, libraryExtension))
-            ret.insert({name, fmt::format("{}/{}", path, name)});
-    return ret;
-}
\ No newline at end of file
+    return resolveBatch({&target, 1}, options).front();
+}
+
+std::vector<ResolveResult> DependencyExtractor::resolveBatch(std::span<const SharedLibrary> targets,
+                                                             const ExtractorOptions& options,
+                                                             const RootExpansion& expand,
+                                                             const ClassifyCallback& onClassified)
+{
+    Trace::Scope scope("resolve");
+    auto graph = std::make_shared<DependencyGraph>();
+
+    std::vector<LibraryId> roots;
+    for (const auto& target : targets)
+    {
+        auto root = graph->addLibrary(target.name);
+        graph->setPath(root, target.path);
+        graph->setTier(root, LibraryTier::Root);
+        roots.push_back(root);
+    }
+    std::vector<LibraryId> frontier = roots;
+    std::sort(frontier.begin(), frontier.end());
+    frontier.erase(std::unique(frontier.begin(), frontier.end()), frontier.end());
+
+    bool cancelled = false;
+    auto report = [&](LibraryId id, std::optional<LibraryId> requiredBy) {
+        if (!onClassified || cancelled)
+            return;
+        std::optional<LibraryView> parent;
+        if (requiredBy)
+            parent.emplace(*graph, *requiredBy);
+        cancelled = !onClassified(LibraryView(*graph, id), parent ? &*parent : nullptr);
+    };
+    for (auto root : frontier)
+        report(root, std::nullopt);
+
+    auto classify = [&](LibraryId id) {
+        auto tier = LibraryTier::Unmet;
+        if (auto location = options.libraries.find(graph->name(id)))
+        {
+            tier = location->tier;
+            graph->setPath(id, location->path);
+        }
+        graph->setTier(id, tier);
+        return tier;
+    };
+
+    // Whole frontier is scanned at once, results are merged in frontier order so
+    // the outcome does not depend on which worker finished first
+    while (!frontier.empty() && !cancelled)
+    {
+        // Added roots are scanned together with libraries that brought them
+        for (size_t index = 0; expand && index < frontier.size(); ++index)
+        {
+            for (const auto& extra : expand(LibraryView(*graph, frontier[index])))
+            {
+                auto known = graph->find(extra.name);
+                if (known && std::find(roots.cbegin(), roots.cend(), *known) != roots.cend())
+                    continue;
+                auto root = graph->addLibrary(extra.name);
+                roots.push_back(root);
+                // Library already reached as dependency keeps its tier
+                if (known)
+                    continue;
+                graph->setPath(root, extra.path);
+                graph->setTier(root, LibraryTier::Root);
+                frontier.push_back(root);
+                report(root, frontier[index]);
+            }
+        }
+        if (cancelled)
+            break;
+
+        Trace::counter("frontier size", static_cast<int64_t>(frontier.size()));
+        Trace::counter("graph size", static_cast<int64_t>(graph->size()));
+        std::vector<SharedLibrary> scanned;
+        scanned.reserve(frontier.size());
+        for (auto id : frontier)
+            scanned.push_back({.name = std::string(graph->name(id)), .path = std::string(graph->path(id))});
+        std::vector<SharedLibrary*> pending;
+        pending.reserve(scanned.size());
+        for (auto& lib : scanned)
+            pending.push_back(&lib);
+        scanBatch(pending, options.jobs, {});
+
+        std::vector<LibraryId> nextFrontier;
+        for (size_t index = 0; index < frontier.size() && !cancelled; ++index)
+        {
+            auto knownLibs = graph->size();
+            graph->setScanResult(frontier[index], scanned[index]);
+
+            // Libraries added to the graph by this scan result were not seen before
+            for (auto id = static_cast<LibraryId>(knownLibs); id < graph->size(); ++id)
+            {
+                auto tier = classify(id);
+                report(id, frontier[index]);
+                if (tier == LibraryTier::Library || tier == LibraryTier::Scan)
+                    nextFrontier.push_back(id);
+            }
+        }
+        frontier = std::move(nextFrontier);
+    }
+
+    std::vector<ResolveResult> results;
+    results.reserve(roots.size());
+    TransitiveClosures closures(*graph);
+    for (auto root : roots)
+    {
+        std::vector<LibraryId> libsToCopy;
+        std::vector<LibraryId> resolvedLibs;
+        std::vector<LibraryId> unmetLibs;
+        for (auto id : closures.closure(root))
+        {
+            switch (graph->tier(id))
+            {
+            case LibraryTier::Unmet:
+                unmetLibs.push_back(id);
+                break;
+            case LibraryTier::Scan:
+                libsToCopy.push_back(id);
+                [[fallthrough]];
+            default:
+                resolvedLibs.push_back(id);
+                break;
+            }
+        }
+        results.push_back({.graph = graph,
+                           .root = root,
+                           .resolved = {graph, std::move(resolvedLibs)},
+                           .availableForCopy = {graph, std::move(libsToCopy)},
+                           .unmet = {graph, std::move(unmetLibs)}});
+    }
+    return results;
+}
@@ -0,0 +1,194 @@
+#include "dependencygraph.h"
+
+#include <algorithm>
+#include <cstring>
+
+StringId StringPool::intern(std::string_view text)
+{
+    if (auto it = ids.find(text); it != ids.end())
+        return it->second;
+
+    char* stored = nullptr;
+    if (text.size() > BLOCK_SIZE)
+    {
+        // Oversized strings get a block of their own, the last block is still being filled
+        auto position = blocks.empty() ? blocks.end() : blocks.end() - 1;
+        stored = blocks.insert(position, std::make_unique<char[]>(text.size()))->get();
+    }
+    else
+    {
+        if (blocks.empty() || text.size() > BLOCK_SIZE - blockUsed)
+        {
+            blocks.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+            blockUsed = 0;
+        }
+        stored = blocks.back().get() + blockUsed;
+        blockUsed += text.size();
+    }
+    std::memcpy(stored, text.data(), text.size());
+
+    auto id = static_cast<StringId>(strings.size());
+    strings.emplace_back(stored, text.size());
+    ids.insert({strings.back(), id});
+    return id;
+}
+
+std::optional<StringId> StringPool::find(std::string_view text) const
+{
+    if (auto it = ids.find(text); it != ids.end())
+        return it->second;
+    return std::nullopt;
+}
+
+LibraryId DependencyGraph::addLibrary(std::string_view name)
+{
+    auto nameId = strings.intern(name);
+    if (auto it = byName.find(nameId); it != byName.end())
+        return it->second;
+
+    auto id = static_cast<LibraryId>(nodes.size());
+    nodes.push_back({.name = nameId, .path = emptyString, .soname = emptyString});
+    byName.insert({nameId, id});
+    return id;
+}
+
+std::optional<LibraryId> DependencyGraph::find(std::string_view name) const
+{
+    auto nameId = strings.find(name);
+    if (!nameId)
+        return std::nullopt;
+    if (auto it = byName.find(*nameId); it != byName.end())
+        return it->second;
+    return std::nullopt;
+}
+
+void DependencyGraph::setScanResult(LibraryId id, const SharedLibrary& scanned)
+{
+    auto edgeBegin = static_cast<uint32_t>(edges.size());
+    for (const auto& dependency : scanned.dependencies)
+        edges.push_back(addLibrary(dependency));
+
+    auto& node = nodes[id];
+    node.edgeBegin = edgeBegin;
+    node.edgeCount = static_cast<uint32_t>(edges.size()) - edgeBegin;
+    node.soname = strings.intern(scanned.soname);
+    node.scanned = scanned.scanned;
+}
+
+SharedLibrary DependencyGraph::toSharedLibrary(LibraryId id) const
+{
+    SharedLibrary library{.name = std::string(name(id)),
+                          .path = std::string(path(id)),
+                          .soname = std::string(soname(id)),
+                          .scanned = scanned(id)};
+    for (auto dependency : dependencies(id))
+        library.dependencies.emplace(name(dependency));
+    return library;
+}
+
+TransitiveClosures::TransitiveClosures(const DependencyGraph& graph)
+    : graph(graph), index(graph.size(), UNVISITED), lowLink(graph.size(), 0), component(graph.size(), UNVISITED),
+      onStack(graph.size(), false)
+{
+}
+
+const std::vector<LibraryId>& TransitiveClosures::closure(LibraryId id)
+{
+    if (index[id] == UNVISITED)
+        computeComponents(id);
+    return componentClosures[component[id]];
+}
+
+void TransitiveClosures::computeComponents(LibraryId start)
+{
+    struct Frame
+    {
+        LibraryId library;
+        uint32_t edge;
+    };
+
+    auto visit = [this](LibraryId id) {
+        index[id] = lowLink[id] = nextIndex++;
+        stack.push_back(id);
+        onStack[id] = true;
+    };
+
+    // Iterative Tarjan, dependency chains can be deeper than the call stack
+    std::vector<Frame> frames{{start, 0}};
+    visit(start);
+    while (!frames.empty())
+    {
+        auto& frame = frames.back();
+        auto dependencies = graph.dependencies(frame.library);
+        if (frame.edge < dependencies.size())
+        {
+            auto dependency = dependencies[frame.edge++];
+            if (index[dependency] == UNVISITED)
+            {
+                visit(dependency);
+                frames.push_back({dependency, 0});
+            }
+            else if (onStack[dependency])
+                lowLink[frame.library] = std::min(lowLink[frame.library], index[dependency]);
+            continue;
+        }
+
+        auto library = frame.library;
+        frames.pop_back();
+        if (!frames.empty())
+            lowLink[frames.back().library] = std::min(lowLink[frames.back().library], lowLink[library]);
+        if (lowLink[library] != index[library])
+            continue;
+
+        // Library is root of a component, all components it depends on are already done
+        auto componentId = static_cast<uint32_t>(componentClosures.size());
+        std::vector<LibraryId> members;
+        LibraryId member;
+        do
+        {
+            member = stack.back();
+            stack.pop_back();
+            onStack[member] = false;
+            component[member] = componentId;
+            members.push_back(member);
+        } while (member != library);
+
+        std::vector<LibraryId> reachable = members;
+        for (auto id : members)
+            for (auto dependency : graph.dependencies(id))
+                if (component[dependency] != componentId)
+                {
+                    const auto& other = componentClosures[component[dependency]];
+                    reachable.insert(reachable.end(), other.begin(), other.end());
+                }
+        std::sort(reachable.begin(), reachable.end());
+        reachable.erase(std::unique(reachable.begin(), reachable.end()), reachable.end());
+        componentClosures.push_back(std::move(reachable));
+    }
+}
+
+LibraryList::LibraryList(std::shared_ptr<const DependencyGraph> graph, std::vector<LibraryId> ids)
+    : graph(std::move(graph)), libraryIds(std::move(ids))
+{
+    std::sort(libraryIds.begin(), libraryIds.end(),
+              [this](auto lhs, auto rhs) { return this->graph->name(lhs) < this->graph->name(rhs); });
+}
+
+bool LibraryList::contains(std::string_view name) const
+{
+    auto it = std::lower_bound(libraryIds.cbegin(), libraryIds.cend(), name,
+                               [this](auto id, auto value) { return graph->name(id) < value; });
+    return it != libraryIds.cend() && graph->name(*it) == name;
+}
+
+SharedLibraries LibraryList::toSharedLibraries() const
+{
+    SharedLibraries libraries;
+    for (auto id : libraryIds)
+    {
+        auto library = graph->toSharedLibrary(id);
+        auto name = library.name;
+        libraries.insert({std::move(name), std::move(library)});
+    }
+    return libraries;
+}
@@ -0,0 +1,367 @@
+#include "deployer.h"
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <string_view>
+#include <thread>
+
+#include "contenthash.h"
+#include "elfstripper.h"
+#include "mappedfile.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+// Target of metadata link of source that is deployed without stripping
+constexpr std::string_view AS_IS = "as-is";
+
+class Descriptor
+{
+public:
+    explicit Descriptor(int fd) : fd(fd) {}
+    Descriptor(const Descriptor&) = delete;
+    Descriptor& operator=(const Descriptor&) = delete;
+    ~Descriptor()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    int get() const { return fd; }
+
+private:
+    int fd;
+};
+
+bool sameContent(const std::string& source, const std::string& target)
+{
+    MappedFile sourceFile;
+    MappedFile targetFile;
+    if (!sourceFile.open(source) || !targetFile.open(target) || sourceFile.size() != targetFile.size())
+        return false;
+    return sourceFile.size() == 0 || std::memcmp(sourceFile.data(), targetFile.data(), sourceFile.size()) == 0;
+}
+
+bool copyContent(int sourceFd, int targetFd, uint64_t size)
+{
+    // In kernel copy, on some filesystems (NFS, btrfs, XFS) it is done without moving data at all
+    uint64_t done = 0;
+    while (done < size)
+    {
+        auto length = copy_file_range(sourceFd, nullptr, targetFd, nullptr, size - done, 0);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            break;
+        done += length;
+    }
+    if (done == size)
+        return true;
+    if (done > 0 || lseek(sourceFd, 0, SEEK_SET) != 0)
+        return false;
+
+    char buffer[64 * 1024];
+    while (true)
+    {
+        auto length = read(sourceFd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            return length == 0;
+        for (ssize_t written = 0; written < length;)
+        {
+            auto chunk = write(targetFd, buffer + written, length - written);
+            if (chunk < 0 && errno == EINTR)
+                continue;
+            if (chunk <= 0)
+                return false;
+            written += chunk;
+        }
+    }
+}
+} // namespace
+
+Deployer::Deployer(bool allowHardlinks) : hardlinks(allowHardlinks)
+{
+}
+
+void Deployer::enableStripping(std::string cacheDirectory)
+{
+    stripCache = std::move(cacheDirectory);
+}
+
+bool Deployer::deploy(std::span<const std::string> files, const std::string& directory, unsigned jobs)
+{
+    std::atomic<bool> status = true;
+    Parallel::forEachIndex(files.size(), jobs, [&](size_t index) {
+        if (deployFile(files[index], directory) == Method::Failed)
+            status = false;
+    });
+    return status;
+}
+
+Deployer::Stats Deployer::stats() const
+{
+    return {.unchanged = unchanged,
+            .cloned = cloned,
+            .linked = linked,
+            .copied = copied,
+            .failed = failed,
+            .bytesWritten = bytesWritten,
+            .bytesAvoided = bytesAvoided,
+            .stripped = stripped,
+            .bytesStripped = bytesStripped};
+}
+
+std::optional<std::string> Deployer::strippedCopy(const std::string& source, const std::string& name,
+                                                  const struct stat& sourceInfo)
+{
+    // Symbolic link named by file metadata points to copy named by content, so unchanged sources are not read
+    uint64_t metadata[] = {sourceInfo.st_dev, sourceInfo.st_ino, static_cast<uint64_t>(sourceInfo.st_size),
+                           static_cast<uint64_t>(sourceInfo.st_mtim.tv_sec),
+                           static_cast<uint64_t>(sourceInfo.st_mtim.tv_nsec)};
+    auto index = fmt::format("{}/{:016x}-{}.link", stripCache, contentHash(std::as_bytes(std::span(metadata))), name);
+    std::error_code error;
+    if (auto linked = std::filesystem::read_symlink(index, error); !error)
+    {
+        if (linked == AS_IS)
+            return std::nullopt;
+        auto cached = fmt::format("{}/{}", stripCache, linked.string());
+        if (access(cached.c_str(), F_OK) == 0)
+            return cached;
+    }
+
+    auto thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    auto record = [&](const std::string& linked) {
+        auto temporary = fmt::format("{}.{}.tmp", index, thread);
+        unlink(temporary.c_str());
+        if (symlink(linked.c_str(), temporary.c_str()) != 0 || rename(temporary.c_str(), index.c_str()) != 0)
+            unlink(temporary.c_str());
+    };
+
+    MappedFile sourceFile;
+    if (!sourceFile.open(source))
+        return std::nullopt;
+    auto cachedName = fmt::format("{:016x}-{}", contentHash(sourceFile.bytes()), name);
+    auto cached = fmt::format("{}/{}", stripCache, cachedName);
+    if (access(cached.c_str(), F_OK) != 0)
+    {
+        Trace::Scope scope("strip file", source);
+        auto temporary = fmt::format("{}.{}.tmp", cached, thread);
+        Descriptor fd(open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755));
+        if (fd.get() < 0)
+        {
+            spdlog::warn("Cannot write stripped copy {}: {}", temporary, std::strerror(errno));
+            return std::nullopt;
+        }
+        errno = 0;
+        if (!ElfStripper::strip(sourceFile.bytes(), fd.get()))
+        {
+            // Not ELF or nothing to strip (nothing written, no write error): deployed as it is from now on
+            if (errno == 0 && lseek(fd.get(), 0, SEEK_CUR) == 0)
+                record(std::string(AS_IS));
+            unlink(temporary.c_str());
+            return std::nullopt;
+        }
+        if (rename(temporary.c_str(), cached.c_str()) != 0)
+        {
+            unlink(temporary.c_str());
+            return std::nullopt;
+        }
+    }
+    record(cachedName);
+    return cached;
+}
+
+Deployer::Method Deployer::deployFile(const std::string& source, const std::string& directory)
+{
+    Trace::Scope scope("deploy file", source);
+    auto name = std::filesystem::path(source).filename().string();
+    auto target = fmt::format("{}/{}", directory, name);
+
+    struct stat sourceInfo;
+    if (stat(source.c_str(), &sourceInfo) != 0)
+    {
+        spdlog::error("Cannot deploy {}: {}", source, std::strerror(errno));
+        ++failed;
+        return Method::Failed;
+    }
+
+    // Stripped copy is deployed in place of source, with mtime of source
+    auto content = source;
+    struct stat contentInfo = sourceInfo;
+    std::optional<uint64_t> removedBytes;
+    if (!stripCache.empty())
+    {
+        if (auto copy = strippedCopy(source, name, sourceInfo); copy && stat(copy->c_str(), &contentInfo) == 0)
+        {
+            if (contentInfo.st_mtim.tv_sec != sourceInfo.st_mtim.tv_sec ||
+                contentInfo.st_mtim.tv_nsec != sourceInfo.st_mtim.tv_nsec)
+            {
+                timespec times[2] = {sourceInfo.st_atim, sourceInfo.st_mtim};
+                utimensat(AT_FDCWD, copy->c_str(), times, 0);
+                contentInfo.st_mtim = sourceInfo.st_mtim;
+            }
+            content = std::move(*copy);
+            removedBytes = sourceInfo.st_size - contentInfo.st_size;
+        }
+        else
+        {
+            contentInfo = sourceInfo;
+        }
+    }
+    auto size = static_cast<uint64_t>(contentInfo.st_size);
+
+    struct stat targetInfo;
+    if (stat(target.c_str(), &targetInfo) == 0 && targetInfo.st_size == contentInfo.st_size)
+    {
+        bool sameTime = targetInfo.st_mtim.tv_sec == contentInfo.st_mtim.tv_sec &&
+                        targetInfo.st_mtim.tv_nsec == contentInfo.st_mtim.tv_nsec;
+        if (sameTime || sameContent(content, target))
+        {
+            // Next time size and mtime are enough
+            if (!sameTime)
+            {
+                timespec times[2] = {contentInfo.st_atim, contentInfo.st_mtim};
+                utimensat(AT_FDCWD, target.c_str(), times, 0);
+            }
+            ++unchanged;
+            bytesAvoided += size;
+            return Method::Unchanged;
+        }
+    }
+
+    // Unique per thread, architectures deploying into one directory do not collide
+    auto temporary =
+        fmt::format("{}/.{}.{}.tmp", directory, name, std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    unlink(temporary.c_str());
+    auto method = Method::Failed;
+    if (hardlinks && link(content.c_str(), temporary.c_str()) == 0)
+    {
+        method = Method::Linked;
+    }
+    else
+    {
+        Descriptor sourceFd(open(content.c_str(), O_RDONLY | O_CLOEXEC));
+        Descriptor targetFd(sourceFd.get() < 0 ? -1
+                                               : open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                                      sourceInfo.st_mode & 07777));
+        if (targetFd.get() >= 0)
+        {
+            if (ioctl(targetFd.get(), FICLONE, sourceFd.get()) == 0)
+                method = Method::Cloned;
+            else if (copyContent(sourceFd.get(), targetFd.get(), size))
+                method = Method::Copied;
+            if (method != Method::Failed)
+            {
+                timespec times[2] = {contentInfo.st_atim, contentInfo.st_mtim};
+                futimens(targetFd.get(), times);
+            }
+        }
+    }
+
+    if (method != Method::Failed && rename(temporary.c_str(), target.c_str()) != 0)
+        method = Method::Failed;
+    // Counted only when stripped copy got into deploy directory
+    if (method != Method::Failed && removedBytes)
+    {
+        ++stripped;
+        bytesStripped += *removedBytes;
+    }
+    auto error = errno;
+    switch (method)
+    {
+    case Method::Cloned:
+        ++cloned;
+        bytesAvoided += size;
+        break;
+    case Method::Linked:
+        ++linked;
+        bytesAvoided += size;
+        break;
+    case Method::Copied:
+        ++copied;
+        bytesWritten += size;
+        break;
+    default:
+        spdlog::error("Cannot deploy {} to {}: {}", source, directory, std::strerror(error));
+        unlink(temporary.c_str());
+        ++failed;
+        break;
+    }
+    return method;
+}
+
+DeployQueue::DeployQueue(Deployer& deployer, std::string directory, unsigned jobs, Callback onDeployed)
+    : deployer(deployer), directory(std::move(directory)), onDeployed(std::move(onDeployed))
+{
+    for (unsigned worker = 0; worker < std::max(1u, jobs); ++worker)
+        workers.emplace_back([this]() { work(); });
+}
+
+DeployQueue::~DeployQueue()
+{
+    finish();
+}
+
+void DeployQueue::add(const std::string& file)
+{
+    {
+        std::lock_guard lock(mutex);
+        if (finished || !added.insert(file).second)
+            return;
+        pending.push_back(file);
+    }
+    available.notify_one();
+}
+
+void DeployQueue::cancel()
+{
+    std::lock_guard lock(mutex);
+    pending.clear();
+}
+
+bool DeployQueue::finish()
+{
+    {
+        std::lock_guard lock(mutex);
+        finished = true;
+    }
+    available.notify_all();
+    workers.clear();
+    return !failed;
+}
+
+void DeployQueue::work()
+{
+    while (true)
+    {
+        std::string file;
+        {
+            std::unique_lock lock(mutex);
+            available.wait(lock, [this]() { return finished || !pending.empty(); });
+            if (pending.empty())
+                return;
+            file = std::move(pending.front());
+            pending.pop_front();
+        }
+
+        auto method = deployer.deployFile(file, directory);
+        std::lock_guard lock(callbackMutex);
+        if (method == Deployer::Method::Failed)
+            failed = true;
+        if (onDeployed)
+            onDeployed(file, method);
+    }
+}
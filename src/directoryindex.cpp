@@ -0,0 +1,368 @@
+#include "directoryindex.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <map>
+#include <spdlog/spdlog.h>
+
+#include "mappedfile.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+constexpr char CACHE_MAGIC[8] = {'D', 'S', 'D', 'I', 'R', 'S', '\0', '\0'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t directoryCount;
+    uint64_t referenceCount;
+    uint64_t stringsSize;
+};
+
+struct DirectoryRecord
+{
+    int64_t mtime;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t extensionOffset;
+    uint32_t extensionLength;
+    uint32_t namesBegin;
+    uint32_t namesCount;
+};
+
+struct StringReference
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Bits per indexed name, with three probes gives false positive rate around 0.3%
+constexpr size_t FILTER_BITS_PER_NAME = 16;
+constexpr unsigned FILTER_PROBES = 3;
+
+uint64_t hashName(std::string_view text)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto character : text)
+    {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template <typename Function>
+void forEachFilterBit(uint64_t hash, size_t bitCount, Function&& function)
+{
+    auto step = (hash >> 29) | 1;
+    for (unsigned probe = 0; probe < FILTER_PROBES; ++probe)
+        function((hash + probe * step) & (bitCount - 1));
+}
+
+std::optional<int64_t> directoryMtime(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+        return std::nullopt;
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+std::vector<std::string> listDirectory(const std::string& path, const std::string& extension)
+{
+    Trace::Scope scope("scanDirectory", path);
+    std::vector<std::string> ret;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+        if (it->path().extension() == extension)
+            ret.push_back(it->path().filename());
+    if (error)
+        spdlog::error("Cannot list directory {}: {}", path, error.message());
+    return ret;
+}
+} // namespace
+
+DirectoryCache::DirectoryCache(std::string path) : cachePath(std::move(path))
+{
+}
+
+bool DirectoryCache::load()
+{
+    if (!std::filesystem::exists(cachePath))
+        return true;
+    MappedFile mapping;
+    if (!mapping.open(cachePath))
+    {
+        spdlog::error("Cannot open directory cache {}", cachePath);
+        return false;
+    }
+
+    auto bytes = mapping.bytes();
+    Header header;
+    bool valid = bytes.size() >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        auto expectedSize = sizeof(Header) + header.directoryCount * sizeof(DirectoryRecord) +
+                            header.referenceCount * sizeof(StringReference) + header.stringsSize;
+        valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && header.version == CACHE_VERSION &&
+                expectedSize == bytes.size();
+    }
+    if (!valid)
+    {
+        spdlog::warn("Ignoring invalid directory cache {}", cachePath);
+        return true;
+    }
+
+    auto records = reinterpret_cast<const DirectoryRecord*>(mapping.data() + sizeof(Header));
+    auto references = reinterpret_cast<const StringReference*>(records + header.directoryCount);
+    auto strings = reinterpret_cast<const char*>(references + header.referenceCount);
+    bool truncated = false;
+    auto text = [&](uint32_t offset, uint32_t length) {
+        if (offset + static_cast<uint64_t>(length) <= header.stringsSize)
+            return std::string(strings + offset, length);
+        truncated = true;
+        return std::string();
+    };
+
+    std::lock_guard lock(mutex);
+    for (uint64_t index = 0; index < header.directoryCount; ++index)
+    {
+        const auto& record = records[index];
+        if (record.namesBegin + static_cast<uint64_t>(record.namesCount) > header.referenceCount)
+            break;
+        Listing listing{.mtime = record.mtime, .extension = text(record.extensionOffset, record.extensionLength)};
+        listing.names.reserve(record.namesCount);
+        for (uint32_t name = 0; name < record.namesCount; ++name)
+        {
+            const auto& reference = references[record.namesBegin + name];
+            listing.names.push_back(text(reference.offset, reference.length));
+        }
+        if (truncated)
+            break;
+        listings.insert({text(record.pathOffset, record.pathLength), std::move(listing)});
+    }
+    if (truncated)
+    {
+        spdlog::warn("Ignoring invalid directory cache {}", cachePath);
+        listings.clear();
+    }
+    return true;
+}
+
+std::optional<std::vector<std::string>> DirectoryCache::lookup(const std::string& directory,
+                                                               const std::string& extension, int64_t mtime)
+{
+    {
+        std::lock_guard lock(mutex);
+        if (auto it = listings.find(directory);
+            it != listings.end() && it->second.mtime == mtime && it->second.extension == extension)
+        {
+            ++hitCount;
+            return it->second.names;
+        }
+    }
+    ++missCount;
+    return std::nullopt;
+}
+
+void DirectoryCache::store(const std::string& directory, const std::string& extension, int64_t mtime,
+                           std::vector<std::string> names)
+{
+    std::lock_guard lock(mutex);
+    listings.insert_or_assign(directory, Listing{.mtime = mtime, .extension = extension, .names = std::move(names)});
+    modified = true;
+}
+
+void DirectoryCache::invalidate(const std::string& directory)
+{
+    std::lock_guard lock(mutex);
+    if (listings.erase(directory) > 0)
+        modified = true;
+}
+
+bool DirectoryCache::save()
+{
+    std::lock_guard lock(mutex);
+    if (!modified)
+        return true;
+
+    std::vector<DirectoryRecord> records;
+    std::vector<StringReference> references;
+    std::string strings;
+    auto addString = [&strings](std::string_view text) {
+        StringReference reference{.offset = static_cast<uint32_t>(strings.size()),
+                                  .length = static_cast<uint32_t>(text.size())};
+        strings.append(text);
+        return reference;
+    };
+
+    // Sorted, so the same listings always give the same file
+    std::map<std::string_view, const Listing*> sorted;
+    for (const auto& [path, listing] : listings)
+        sorted.insert({path, &listing});
+    records.reserve(sorted.size());
+    for (const auto& [path, listing] : sorted)
+    {
+        auto pathReference = addString(path);
+        auto extension = addString(listing->extension);
+        records.push_back({.mtime = listing->mtime,
+                           .pathOffset = pathReference.offset,
+                           .pathLength = pathReference.length,
+                           .extensionOffset = extension.offset,
+                           .extensionLength = extension.length,
+                           .namesBegin = static_cast<uint32_t>(references.size()),
+                           .namesCount = static_cast<uint32_t>(listing->names.size())});
+        for (const auto& name : listing->names)
+            references.push_back(addString(name));
+    }
+
+    Header header{.version = CACHE_VERSION,
+                  .reserved = 0,
+                  .directoryCount = records.size(),
+                  .referenceCount = references.size(),
+                  .stringsSize = strings.size()};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+
+    auto temporaryPath = cachePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            spdlog::error("Cannot write directory cache {}", temporaryPath);
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(DirectoryRecord));
+        file.write(reinterpret_cast<const char*>(references.data()), references.size() * sizeof(StringReference));
+        file.write(strings.data(), strings.size());
+        if (!file)
+        {
+            spdlog::error("Cannot write directory cache {}", temporaryPath);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error)
+    {
+        spdlog::error("Cannot replace directory cache {}: {}", cachePath, error.message());
+        return false;
+    }
+    modified = false;
+    return true;
+}
+
+void DirectoryIndex::addDirectories(std::span<const Directory> paths, const std::string& extension, unsigned jobs,
+                                    DirectoryCache* cache)
+{
+    std::vector<std::vector<std::string>> listings(paths.size());
+    Parallel::forEachIndex(paths.size(), jobs, [&](size_t index) {
+        const auto& path = paths[index].path;
+        auto mtime = cache ? directoryMtime(path) : std::nullopt;
+        if (mtime)
+        {
+            if (auto names = cache->lookup(path, extension, *mtime))
+            {
+                listings[index] = std::move(*names);
+                return;
+            }
+        }
+        listings[index] = listDirectory(path, extension);
+        if (mtime)
+            cache->store(path, extension, *mtime, listings[index]);
+    });
+
+    for (size_t index = 0; index < paths.size(); ++index)
+    {
+        auto directory = static_cast<uint32_t>(directories.size());
+        directories.push_back(paths[index].path);
+        for (const auto& name : listings[index])
+            add(paths[index].tier, directory, name);
+    }
+    rebuildFilter();
+}
+
+void DirectoryIndex::addArchiveDirectory(LibraryTier tier, const ZipArchive& archive, const std::string& directory,
+                                         const std::string& extension)
+{
+    auto prefix = directory + '/';
+    auto entries = archive.entries();
+    auto it = std::lower_bound(entries.begin(), entries.end(), prefix,
+                               [](const auto& entry, const std::string& value) { return entry.name < value; });
+    auto index = static_cast<uint32_t>(directories.size());
+    directories.push_back(ZipArchive::entryPath(archive.path(), directory));
+    for (; it != entries.end() && it->name.starts_with(prefix); ++it)
+    {
+        auto name = it->name.substr(prefix.size());
+        if (name.find('/') == std::string_view::npos && name.ends_with(extension))
+            add(tier, index, name);
+    }
+    rebuildFilter();
+}
+
+void DirectoryIndex::addLibraries(LibraryTier tier, const std::set<std::string>& libraries)
+{
+    for (const auto& name : libraries)
+        add(tier, NO_DIRECTORY, name);
+    rebuildFilter();
+}
+
+void DirectoryIndex::add(LibraryTier tier, uint32_t directory, std::string_view name)
+{
+    auto id = names.intern(name);
+    if (id < entries.size())
+        return;
+    entries.push_back({.tier = tier, .directory = directory});
+}
+
+size_t DirectoryIndex::size(LibraryTier tier) const
+{
+    size_t count = 0;
+    for (const auto& entry : entries)
+        if (entry.tier == tier)
+            ++count;
+    return count;
+}
+
+void DirectoryIndex::rebuildFilter()
+{
+    size_t bitCount = 64;
+    while (bitCount < entries.size() * FILTER_BITS_PER_NAME)
+        bitCount <<= 1;
+    filter.assign(bitCount / 64, 0);
+    for (StringId id = 0; id < names.size(); ++id)
+        forEachFilterBit(hashName(names.at(id)), bitCount,
+                         [this](size_t bit) { filter[bit / 64] |= uint64_t(1) << (bit % 64); });
+}
+
+bool DirectoryIndex::mayContain(std::string_view name) const
+{
+    if (filter.empty())
+        return false;
+    bool present = true;
+    forEachFilterBit(hashName(name), filter.size() * 64,
+                     [&](size_t bit) { present = present && (filter[bit / 64] >> (bit % 64)) & 1; });
+    return present;
+}
+
+std::optional<DirectoryIndex::Location> DirectoryIndex::find(std::string_view name) const
+{
+    if (!mayContain(name))
+        return std::nullopt;
+    auto id = names.find(name);
+    if (!id)
+        return std::nullopt;
+    const auto& entry = entries[*id];
+    if (entry.directory == NO_DIRECTORY)
+        return Location{.tier = entry.tier, .path = std::string(name)};
+    return Location{.tier = entry.tier, .path = fmt::format("{}/{}", directories[entry.directory], name)};
+}
@@ -0,0 +1,34 @@
+#include "elfdependencyextractor.h"
+
+#include <spdlog/spdlog.h>
+
+#include "elffile.h"
+#include "trace.h"
+
+void ElfDependencyExtractor::addArchive(std::shared_ptr<const ZipArchive> archive)
+{
+    archives.push_back(std::move(archive));
+}
+
+void ElfDependencyExtractor::scanDependencies(SharedLibrary& target)
+{
+    Trace::Scope scope("scan elf", target.path);
+    LibraryFile file;
+    if (!file.open(target.path, archives))
+    {
+        spdlog::error("Cannot open file {}", target.path);
+        return;
+    }
+
+    ElfFile elf(file.bytes());
+    if (!elf.isValid())
+    {
+        spdlog::error("Cannot read {}: {}", target.path, elf.errorString());
+        return;
+    }
+
+    for (auto library : elf.neededLibraries())
+        target.dependencies.emplace(library);
+    target.soname = elf.soname();
+    target.scanned = true;
+}
@@ -0,0 +1,475 @@
+#include "elffile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+constexpr unsigned char ELF_MAGIC[] = {0x7f, 'E', 'L', 'F'};
+constexpr size_t EI_CLASS = 4;
+constexpr size_t EI_DATA = 5;
+constexpr unsigned char ELFCLASS32 = 1;
+constexpr unsigned char ELFCLASS64 = 2;
+constexpr unsigned char ELFDATA2LSB = 1;
+constexpr unsigned char ELFDATA2MSB = 2;
+} // namespace
+
+ElfFile::ElfFile(std::span<const std::byte> image) : data(image)
+{
+    parseHeader();
+}
+
+bool ElfFile::fits(uint64_t offset, uint64_t size) const
+{
+    return offset <= data.size() && size <= data.size() - offset;
+}
+
+uint64_t ElfFile::read(uint64_t offset, size_t size) const
+{
+    if (!fits(offset, size))
+        return 0;
+    unsigned char bytes[8];
+    std::memcpy(bytes, data.data() + offset, size);
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        auto byte = bigEndian ? bytes[i] : bytes[size - 1 - i];
+        value = (value << 8) | byte;
+    }
+    return value;
+}
+
+void ElfFile::parseHeader()
+{
+    if (!fits(0, 16) || std::memcmp(data.data(), ELF_MAGIC, sizeof(ELF_MAGIC)) != 0)
+    {
+        errorMessage = "not an ELF file";
+        return;
+    }
+
+    auto elfClass = static_cast<unsigned char>(data[EI_CLASS]);
+    auto elfData = static_cast<unsigned char>(data[EI_DATA]);
+    if ((elfClass != ELFCLASS32 && elfClass != ELFCLASS64) || (elfData != ELFDATA2LSB && elfData != ELFDATA2MSB))
+    {
+        errorMessage = "unsupported ELF class or data encoding";
+        return;
+    }
+    elf64 = elfClass == ELFCLASS64;
+    bigEndian = elfData == ELFDATA2MSB;
+
+    const uint64_t headerSize = elf64 ? 64 : 52;
+    if (!fits(0, headerSize))
+    {
+        errorMessage = "truncated ELF header";
+        return;
+    }
+
+    segmentsEnd = headerSize;
+    machineType = static_cast<uint16_t>(read(18, 2));
+    uint64_t programHeaderOffset = elf64 ? read(32, 8) : read(28, 4);
+    uint64_t programHeaderSize = read(elf64 ? 54 : 42, 2);
+    uint64_t programHeaderCount = read(elf64 ? 56 : 44, 2);
+    if (programHeaderCount == 0)
+        return;
+
+    const uint64_t minimalEntrySize = elf64 ? 56 : 32;
+    if (programHeaderSize < minimalEntrySize || !fits(programHeaderOffset, programHeaderSize * programHeaderCount))
+    {
+        errorMessage = "invalid program header table";
+        return;
+    }
+    segmentsEnd = std::max(segmentsEnd, programHeaderOffset + programHeaderSize * programHeaderCount);
+
+    std::optional<Segment> dynamicSegment;
+    for (uint64_t index = 0; index < programHeaderCount; ++index)
+    {
+        auto entry = programHeaderOffset + index * programHeaderSize;
+        auto type = static_cast<uint32_t>(read(entry, 4));
+        auto fileEnd = elf64 ? read(entry + 8, 8) + read(entry + 32, 8) : read(entry + 4, 4) + read(entry + 16, 4);
+        segmentsEnd = std::max(segmentsEnd, std::min<uint64_t>(fileEnd, data.size()));
+        if (type != Elf::PT_LOAD && type != Elf::PT_DYNAMIC)
+            continue;
+
+        Segment segment;
+        if (elf64)
+            segment = {.offset = read(entry + 8, 8), .address = read(entry + 16, 8), .fileSize = read(entry + 32, 8)};
+        else
+            segment = {.offset = read(entry + 4, 4), .address = read(entry + 8, 4), .fileSize = read(entry + 16, 4)};
+
+        if (type == Elf::PT_LOAD)
+            loadSegments.push_back(segment);
+        else
+            dynamicSegment = segment;
+    }
+
+    if (dynamicSegment)
+        parseDynamic(dynamicSegment->offset, dynamicSegment->fileSize);
+}
+
+void ElfFile::parseDynamic(uint64_t offset, uint64_t size)
+{
+    if (!fits(offset, size))
+    {
+        errorMessage = "dynamic segment outside of file";
+        return;
+    }
+
+    const uint64_t entrySize = elf64 ? 16 : 8;
+    for (uint64_t entry = offset; entry + entrySize <= offset + size; entry += entrySize)
+    {
+        auto tag = static_cast<int64_t>(readWord(entry));
+        if (!elf64)
+            tag = static_cast<int32_t>(tag);
+        if (tag == Elf::DT_NULL)
+            break;
+        dynamic.push_back({.tag = tag, .value = readWord(entry + entrySize / 2)});
+    }
+
+    auto tableAddress = dynamicValue(Elf::DT_STRTAB);
+    auto tableSize = dynamicValue(Elf::DT_STRSZ);
+    if (!tableAddress || !tableSize)
+        return;
+
+    auto tableOffset = fileOffset(*tableAddress);
+    if (!tableOffset || !fits(*tableOffset, *tableSize))
+    {
+        errorMessage = "dynamic string table outside of file";
+        return;
+    }
+    stringTable = {reinterpret_cast<const char*>(data.data() + *tableOffset), static_cast<size_t>(*tableSize)};
+}
+
+void ElfFile::parseSymbolTables() const
+{
+    if (symbolsParsed)
+        return;
+    symbolsParsed = true;
+    auto tableAddress = dynamicValue(Elf::DT_SYMTAB);
+    auto tableOffset = tableAddress ? fileOffset(*tableAddress) : std::nullopt;
+    if (!tableOffset)
+        return;
+    symbolTable = *tableOffset;
+    const uint64_t symbolSize = elf64 ? 24 : 16;
+
+    if (auto address = dynamicValue(Elf::DT_HASH))
+    {
+        // nbucket, nchain, where nchain is number of symbols
+        if (auto offset = fileOffset(*address); offset && fits(*offset, 8))
+        {
+            sysvHashTable = *offset;
+            symbolCount = read(*offset + 4, 4);
+        }
+    }
+    if (auto address = dynamicValue(Elf::DT_GNU_HASH))
+    {
+        if (auto offset = fileOffset(*address); offset && fits(*offset, 16))
+        {
+            auto bucketCount = read(*offset, 4);
+            auto symbolOffset = read(*offset + 4, 4);
+            auto bloomSize = read(*offset + 8, 4);
+            auto buckets = *offset + 16 + bloomSize * (elf64 ? 8 : 4);
+            auto chains = buckets + bucketCount * 4;
+            if (fits(buckets, bucketCount * 4))
+            {
+                gnuHashTable = *offset;
+                if (!sysvHashTable)
+                {
+                    // Symbols after symbolOffset are hashed, last one ends chain of the highest bucket
+                    uint64_t last = 0;
+                    for (uint64_t bucket = 0; bucket < bucketCount; ++bucket)
+                        last = std::max(last, read(buckets + bucket * 4, 4));
+                    if (last >= symbolOffset)
+                        while (fits(chains + (last - symbolOffset) * 4, 4) &&
+                               !(read(chains + (last - symbolOffset) * 4, 4) & 1))
+                            ++last;
+                    symbolCount = last >= symbolOffset ? last + 1 : symbolOffset;
+                }
+            }
+        }
+    }
+    if (!fits(symbolTable, symbolCount * symbolSize))
+    {
+        symbolCount = 0;
+        gnuHashTable = 0;
+        sysvHashTable = 0;
+    }
+}
+
+size_t ElfFile::dynamicSymbolCount() const
+{
+    parseSymbolTables();
+    return symbolCount;
+}
+
+ElfFile::Symbol ElfFile::dynamicSymbol(size_t index) const
+{
+    parseSymbolTables();
+    if (index >= symbolCount)
+        return {};
+    if (elf64)
+    {
+        auto entry = symbolTable + index * 24;
+        auto info = static_cast<uint8_t>(read(entry + 4, 1));
+        return {.name = dynamicString(read(entry, 4)),
+                .binding = static_cast<uint8_t>(info >> 4),
+                .type = static_cast<uint8_t>(info & 0xf),
+                .section = static_cast<uint16_t>(read(entry + 6, 2))};
+    }
+    auto entry = symbolTable + index * 16;
+    auto info = static_cast<uint8_t>(read(entry + 12, 1));
+    return {.name = dynamicString(read(entry, 4)),
+            .binding = static_cast<uint8_t>(info >> 4),
+            .type = static_cast<uint8_t>(info & 0xf),
+            .section = static_cast<uint16_t>(read(entry + 14, 2))};
+}
+
+bool ElfFile::exportsSymbol(std::string_view name, uint32_t hash) const
+{
+    parseSymbolTables();
+    if (gnuHashTable)
+        return lookupGnuHash(name, hash);
+    if (sysvHashTable)
+        return lookupSysvHash(name);
+    for (size_t index = 0; index < symbolCount; ++index)
+        if (auto symbol = dynamicSymbol(index); symbol.name == name && symbol.isExported())
+            return true;
+    return false;
+}
+
+bool ElfFile::lookupGnuHash(std::string_view name, uint32_t hash) const
+{
+    auto bucketCount = read(gnuHashTable, 4);
+    auto symbolOffset = read(gnuHashTable + 4, 4);
+    auto bloomSize = read(gnuHashTable + 8, 4);
+    auto bloomShift = read(gnuHashTable + 12, 4);
+    if (bucketCount == 0 || bloomSize == 0)
+        return false;
+
+    // Two bits of bloom filter word reject most absent names without touching buckets
+    const uint64_t wordBits = elf64 ? 64 : 32;
+    auto word = readWord(gnuHashTable + 16 + (hash / wordBits % bloomSize) * (wordBits / 8));
+    uint64_t mask = (uint64_t(1) << (hash % wordBits)) | (uint64_t(1) << ((hash >> bloomShift) % wordBits));
+    if ((word & mask) != mask)
+        return false;
+
+    auto buckets = gnuHashTable + 16 + bloomSize * (wordBits / 8);
+    auto chains = buckets + bucketCount * 4;
+    auto index = read(buckets + (hash % bucketCount) * 4, 4);
+    if (index < symbolOffset)
+        return false;
+    for (; index < symbolCount; ++index)
+    {
+        auto chainHash = static_cast<uint32_t>(read(chains + (index - symbolOffset) * 4, 4));
+        if ((chainHash | 1) == (hash | 1))
+            if (auto symbol = dynamicSymbol(index); symbol.name == name && symbol.isExported())
+                return true;
+        if (chainHash & 1)
+            break;
+    }
+    return false;
+}
+
+bool ElfFile::lookupSysvHash(std::string_view name) const
+{
+    auto bucketCount = read(sysvHashTable, 4);
+    if (bucketCount == 0)
+        return false;
+    auto chains = sysvHashTable + 8 + bucketCount * 4;
+    auto index = read(sysvHashTable + 8 + (sysvHash(name) % bucketCount) * 4, 4);
+    // Chain length is bounded by symbol count, so broken table cannot loop forever
+    for (size_t steps = 0; index != 0 && index < symbolCount && steps < symbolCount; ++steps)
+    {
+        if (auto symbol = dynamicSymbol(index); symbol.name == name && symbol.isExported())
+            return true;
+        index = read(chains + index * 4, 4);
+    }
+    return false;
+}
+
+uint32_t ElfFile::gnuHash(std::string_view name)
+{
+    uint32_t hash = 5381;
+    for (auto character : name)
+        hash = hash * 33 + static_cast<unsigned char>(character);
+    return hash;
+}
+
+uint32_t ElfFile::sysvHash(std::string_view name)
+{
+    uint32_t hash = 0;
+    for (auto character : name)
+    {
+        hash = (hash << 4) + static_cast<unsigned char>(character);
+        auto high = hash & 0xf0000000;
+        if (high)
+            hash ^= high >> 24;
+        hash &= ~high;
+    }
+    return hash;
+}
+
+std::optional<uint64_t> ElfFile::dynamicValue(int64_t tag) const
+{
+    auto it = std::find_if(dynamic.cbegin(), dynamic.cend(), [tag](const auto& entry) { return entry.tag == tag; });
+    if (it == dynamic.cend())
+        return std::nullopt;
+    return it->value;
+}
+
+std::optional<uint64_t> ElfFile::fileOffset(uint64_t address) const
+{
+    for (const auto& segment : loadSegments)
+        if (address >= segment.address && address - segment.address < segment.fileSize)
+            return segment.offset + (address - segment.address);
+    return std::nullopt;
+}
+
+std::string_view ElfFile::dynamicString(uint64_t offset) const
+{
+    if (offset >= stringTable.size())
+        return {};
+    auto tail = stringTable.substr(offset);
+    return tail.substr(0, tail.find('\0'));
+}
+
+std::vector<std::string_view> ElfFile::neededLibraries() const
+{
+    std::vector<std::string_view> ret;
+    for (const auto& entry : dynamic)
+        if (entry.tag == Elf::DT_NEEDED)
+            if (auto name = dynamicString(entry.value); !name.empty())
+                ret.push_back(name);
+    return ret;
+}
+
+std::string_view ElfFile::soname() const
+{
+    auto offset = dynamicValue(Elf::DT_SONAME);
+    return offset ? dynamicString(*offset) : std::string_view();
+}
+
+ElfFile::LoadCost ElfFile::loadCost() const
+{
+    LoadCost cost;
+    const uint64_t wordSize = elf64 ? 8 : 4;
+    auto relaEntrySize = dynamicValue(Elf::DT_RELAENT).value_or(3 * wordSize);
+    auto relEntrySize = dynamicValue(Elf::DT_RELENT).value_or(2 * wordSize);
+    if (relaEntrySize)
+        cost.relocations += dynamicValue(Elf::DT_RELASZ).value_or(0) / relaEntrySize;
+    if (relEntrySize)
+        cost.relocations += dynamicValue(Elf::DT_RELSZ).value_or(0) / relEntrySize;
+    cost.relocations += packedRelocationCount(Elf::DT_ANDROID_RELA) + packedRelocationCount(Elf::DT_ANDROID_REL) +
+                        relrRelocationCount(Elf::DT_RELR, Elf::DT_RELRSZ) +
+                        relrRelocationCount(Elf::DT_ANDROID_RELR, Elf::DT_ANDROID_RELRSZ);
+
+    auto pltEntrySize = dynamicValue(Elf::DT_PLTREL) == static_cast<uint64_t>(Elf::DT_RELA) ? relaEntrySize
+                                                                                           : relEntrySize;
+    if (pltEntrySize)
+        cost.pltRelocations = dynamicValue(Elf::DT_PLTRELSZ).value_or(0) / pltEntrySize;
+    cost.initFunctions = dynamicValue(Elf::DT_INIT_ARRAYSZ).value_or(0) / wordSize;
+    if (dynamicValue(Elf::DT_INIT))
+        ++cost.initFunctions;
+    return cost;
+}
+
+uint64_t ElfFile::packedRelocationCount(int64_t tableTag) const
+{
+    // "APS2" followed by SLEB128 relocation count
+    auto address = dynamicValue(tableTag);
+    auto offset = address ? fileOffset(*address) : std::nullopt;
+    if (!offset || !fits(*offset, 4) || std::memcmp(data.data() + *offset, "APS2", 4) != 0)
+        return 0;
+    int64_t count = 0;
+    unsigned shift = 0;
+    for (auto position = *offset + 4; fits(position, 1) && shift < 64; ++position, shift += 7)
+    {
+        auto byte = static_cast<uint8_t>(data[position]);
+        count |= static_cast<int64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            if (shift + 7 < 64 && (byte & 0x40))
+                count |= -(int64_t(1) << (shift + 7));
+            return count > 0 ? count : 0;
+        }
+    }
+    return 0;
+}
+
+uint64_t ElfFile::relrRelocationCount(int64_t tableTag, int64_t sizeTag) const
+{
+    // Even entry relocates one address, odd one is bitmap of following words
+    auto address = dynamicValue(tableTag);
+    auto offset = address ? fileOffset(*address) : std::nullopt;
+    auto size = dynamicValue(sizeTag).value_or(0);
+    if (!offset || !fits(*offset, size))
+        return 0;
+    const uint64_t wordSize = elf64 ? 8 : 4;
+    uint64_t count = 0;
+    for (uint64_t entry = *offset; entry + wordSize <= *offset + size; entry += wordSize)
+    {
+        auto value = readWord(entry);
+        count += value & 1 ? std::popcount(value) - 1 : 1;
+    }
+    return count;
+}
+
+std::vector<ElfFile::Section> ElfFile::sections() const
+{
+    std::vector<Section> ret;
+    if (!fits(0, elf64 ? 64 : 52))
+        return ret;
+    uint64_t tableOffset = elf64 ? read(40, 8) : read(32, 4);
+    uint64_t entrySize = read(elf64 ? 58 : 46, 2);
+    uint64_t count = read(elf64 ? 60 : 48, 2);
+    if (entrySize < (elf64 ? 64u : 40u) || !fits(tableOffset, entrySize * count))
+        return ret;
+
+    for (uint64_t index = 0; index < count; ++index)
+    {
+        auto entry = tableOffset + index * entrySize;
+        if (elf64)
+            ret.push_back({.name = static_cast<uint32_t>(read(entry, 4)),
+                           .type = static_cast<uint32_t>(read(entry + 4, 4)),
+                           .flags = read(entry + 8, 8),
+                           .address = read(entry + 16, 8),
+                           .offset = read(entry + 24, 8),
+                           .size = read(entry + 32, 8),
+                           .link = static_cast<uint32_t>(read(entry + 40, 4)),
+                           .info = static_cast<uint32_t>(read(entry + 44, 4)),
+                           .alignment = read(entry + 48, 8),
+                           .entrySize = read(entry + 56, 8)});
+        else
+            ret.push_back({.name = static_cast<uint32_t>(read(entry, 4)),
+                           .type = static_cast<uint32_t>(read(entry + 4, 4)),
+                           .flags = read(entry + 8, 4),
+                           .address = read(entry + 12, 4),
+                           .offset = read(entry + 16, 4),
+                           .size = read(entry + 20, 4),
+                           .link = static_cast<uint32_t>(read(entry + 24, 4)),
+                           .info = static_cast<uint32_t>(read(entry + 28, 4)),
+                           .alignment = read(entry + 32, 4),
+                           .entrySize = read(entry + 36, 4)});
+    }
+    return ret;
+}
+
+uint16_t ElfFile::sectionNamesIndex() const
+{
+    return static_cast<uint16_t>(read(elf64 ? 62 : 50, 2));
+}
+
+std::string_view ElfFile::sectionName(const Section& section, const Section& names) const
+{
+    auto table = sectionContent(names);
+    if (section.name >= table.size())
+        return {};
+    std::string_view text(reinterpret_cast<const char*>(table.data()) + section.name, table.size() - section.name);
+    return text.substr(0, text.find('\0'));
+}
+
+std::span<const std::byte> ElfFile::sectionContent(const Section& section) const
+{
+    if (section.type == Elf::SHT_NOBITS || !fits(section.offset, section.size))
+        return {};
+    return data.subspan(section.offset, section.size);
+}
@@ -0,0 +1,163 @@
+#include "elfstripper.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "elffile.h"
+#include "trace.h"
+
+namespace {
+class Writer
+{
+public:
+    Writer(int fd, bool elf64, bool bigEndian) : fd(fd), elf64(elf64), bigEndian(bigEndian) {}
+
+    bool write(const void* bytes, uint64_t size)
+    {
+        auto data = static_cast<const char*>(bytes);
+        for (uint64_t done = 0; done < size;)
+        {
+            auto length = ::write(fd, data + done, size - done);
+            if (length < 0 && errno == EINTR)
+                continue;
+            if (length <= 0)
+                return false;
+            done += length;
+        }
+        written += size;
+        return true;
+    }
+
+    bool pad(uint64_t alignment)
+    {
+        static const char zeros[64] = {};
+        while (alignment > 1 && written % alignment)
+            if (!write(zeros, std::min<uint64_t>(sizeof(zeros), alignment - written % alignment)))
+                return false;
+        return true;
+    }
+
+    // Stores value in byte order of image
+    void put(std::vector<unsigned char>& buffer, uint64_t offset, uint64_t value, size_t size) const
+    {
+        for (size_t i = 0; i < size; ++i)
+            buffer[offset + (bigEndian ? size - 1 - i : i)] = static_cast<unsigned char>(value >> (8 * i));
+    }
+    void putWord(std::vector<unsigned char>& buffer, uint64_t offset, uint64_t value) const
+    {
+        put(buffer, offset, value, elf64 ? 8 : 4);
+    }
+
+    uint64_t position() const { return written; }
+
+private:
+    int fd;
+    bool elf64;
+    bool bigEndian;
+    uint64_t written = 0;
+};
+} // namespace
+
+std::optional<uint64_t> ElfStripper::strip(std::span<const std::byte> image, int fd)
+{
+    Trace::Scope scope("strip elf");
+    ElfFile elf(image);
+    auto sections = elf.sections();
+    if (!elf.isValid() || sections.empty())
+        return std::nullopt;
+
+    auto namesIndex = elf.sectionNamesIndex();
+    std::vector<uint32_t> newIndex(sections.size(), 0);
+    std::vector<size_t> kept;
+    // Everything up to the end of segments is copied as is, loaded sections live there
+    auto prefixEnd = elf.segmentsSize();
+    for (size_t index = 0; index < sections.size(); ++index)
+    {
+        const auto& section = sections[index];
+        bool keep = index == 0 || index == namesIndex || (section.flags & Elf::SHF_ALLOC) ||
+                    section.type == Elf::SHT_NOTE || section.type == Elf::SHT_ARM_ATTRIBUTES;
+        if (!keep)
+            continue;
+        newIndex[index] = static_cast<uint32_t>(kept.size());
+        kept.push_back(index);
+        if ((section.flags & Elf::SHF_ALLOC) && section.type != Elf::SHT_NOBITS)
+            prefixEnd = std::max(prefixEnd, section.offset + section.size);
+    }
+    if (kept.size() == sections.size() || prefixEnd > image.size())
+        return std::nullopt;
+
+    const bool elf64 = elf.is64Bit();
+    const uint64_t headerSize = elf64 ? 64 : 52;
+    const uint64_t sectionHeaderSize = elf64 ? 64 : 40;
+    Writer writer(fd, elf64, elf.isBigEndian());
+
+    // Offsets of kept sections that are not in the copied prefix
+    std::vector<uint64_t> offsets(sections.size(), 0);
+    std::vector<char> moved(sections.size(), false);
+    uint64_t cursor = prefixEnd;
+    for (auto index : kept)
+    {
+        const auto& section = sections[index];
+        offsets[index] = section.offset;
+        if (index == 0 || section.offset + (section.type == Elf::SHT_NOBITS ? 0 : section.size) <= prefixEnd)
+            continue;
+        auto alignment = std::max<uint64_t>(section.alignment, 1);
+        cursor = (cursor + alignment - 1) / alignment * alignment;
+        offsets[index] = cursor;
+        moved[index] = section.type != Elf::SHT_NOBITS;
+        if (moved[index])
+            cursor += section.size;
+    }
+    auto wordSize = elf64 ? 8 : 4;
+    auto tableOffset = (cursor + wordSize - 1) / wordSize * wordSize;
+
+    std::vector<unsigned char> header(headerSize);
+    std::memcpy(header.data(), image.data(), headerSize);
+    writer.putWord(header, elf64 ? 40 : 32, tableOffset);
+    writer.put(header, elf64 ? 60 : 48, kept.size(), 2);
+    writer.put(header, elf64 ? 62 : 50, newIndex[namesIndex], 2);
+    if (!writer.write(header.data(), header.size()) ||
+        !writer.write(image.data() + headerSize, prefixEnd - headerSize))
+        return std::nullopt;
+
+    for (auto index : kept)
+    {
+        const auto& section = sections[index];
+        if (!moved[index])
+            continue;
+        if (section.offset + section.size > image.size() || !writer.pad(std::max<uint64_t>(section.alignment, 1)) ||
+            !writer.write(image.data() + section.offset, section.size))
+            return std::nullopt;
+    }
+    if (!writer.pad(wordSize))
+        return std::nullopt;
+
+    std::vector<unsigned char> table(kept.size() * sectionHeaderSize);
+    for (size_t position = 0; position < kept.size(); ++position)
+    {
+        const auto& section = sections[kept[position]];
+        auto entry = position * sectionHeaderSize;
+        // Links to removed sections are cleared
+        auto link = section.link < sections.size() ? newIndex[section.link] : 0;
+        auto info = section.info;
+        if ((section.flags & Elf::SHF_INFO_LINK) || section.type == Elf::SHT_REL || section.type == Elf::SHT_RELA)
+            info = section.info < sections.size() ? newIndex[section.info] : 0;
+        writer.put(table, entry, section.name, 4);
+        writer.put(table, entry + 4, section.type, 4);
+        writer.putWord(table, entry + 8, section.flags);
+        writer.putWord(table, entry + (elf64 ? 16 : 12), section.address);
+        writer.putWord(table, entry + (elf64 ? 24 : 16), offsets[kept[position]]);
+        writer.putWord(table, entry + (elf64 ? 32 : 20), section.size);
+        writer.put(table, entry + (elf64 ? 40 : 24), link, 4);
+        writer.put(table, entry + (elf64 ? 44 : 28), info, 4);
+        writer.putWord(table, entry + (elf64 ? 48 : 32), section.alignment);
+        writer.putWord(table, entry + (elf64 ? 56 : 36), section.entrySize);
+    }
+    if (!writer.write(table.data(), table.size()))
+        return std::nullopt;
+    return writer.position();
+}
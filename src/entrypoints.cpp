@@ -0,0 +1,57 @@
+#include "entrypoints.h"
+
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "trace.h"
+
+bool EntryPoints::load(const std::string& appName, const std::string& manifestFile)
+{
+    if (!appName.empty())
+        applicationNames.push_back(appName);
+    if (!std::filesystem::exists(manifestFile))
+        return true;
+
+    Trace::Scope scope("manifest load", manifestFile);
+    using json = nlohmann::json;
+    std::ifstream file(manifestFile);
+    json data = json::parse(file);
+    if (!data.is_object())
+    {
+        spdlog::error("JSON manifest {} is not an object", manifestFile);
+        return false;
+    }
+
+    if (data.contains("applications"))
+        for (const auto& name : data["applications"])
+            applicationNames.push_back(name.get<std::string>());
+    if (data.contains("libraries"))
+        for (const auto& path : data["libraries"])
+            libraries.push_back(path.get<std::string>());
+    return true;
+}
+
+std::vector<SharedLibrary> EntryPoints::librariesOf(const std::string& abi, spdlog::logger& log) const
+{
+    std::vector<SharedLibrary> ret;
+    for (const auto& pattern : libraries)
+    {
+        auto path = libraryPath(pattern, abi);
+        if (!std::filesystem::exists(path))
+        {
+            log.warn("Skipping library for arch {}, file {} does not exists", abi, path);
+            continue;
+        }
+        ret.push_back({.name = std::filesystem::path(path).filename(), .path = path});
+    }
+    return ret;
+}
+
+std::string EntryPoints::libraryPath(std::string pattern, const std::string& abi)
+{
+    if (auto idx = pattern.find("${ANDROID_ABI}"); idx != std::string::npos)
+        pattern.replace(idx, 14, abi);
+    return pattern;
+}
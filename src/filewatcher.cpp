@@ -0,0 +1,85 @@
+#include "filewatcher.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace {
+constexpr uint32_t WATCH_EVENTS =
+    IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+constexpr uint32_t LISTING_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+} // namespace
+
+FileWatcher::FileWatcher() : fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+    if (fd < 0)
+        spdlog::error("Cannot initialize inotify: {}", std::strerror(errno));
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool FileWatcher::watch(const std::string& directory)
+{
+    if (fd < 0)
+        return false;
+    auto wd = inotify_add_watch(fd, directory.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        spdlog::warn("Cannot watch directory {}: {}", directory, std::strerror(errno));
+        return false;
+    }
+    directories[wd] = directory;
+    return true;
+}
+
+FileWatcher::Changes FileWatcher::readChanges()
+{
+    Changes changes;
+    if (fd < 0)
+        return changes;
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true)
+    {
+        auto length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (ssize_t offset = 0; offset < length;)
+        {
+            inotify_event event;
+            std::memcpy(&event, buffer + offset, sizeof(event));
+            const char* name = buffer + offset + sizeof(inotify_event);
+            offset += sizeof(inotify_event) + event.len;
+
+            if (event.mask & IN_Q_OVERFLOW)
+            {
+                changes.lost = true;
+                continue;
+            }
+            auto it = directories.find(event.wd);
+            if (it == directories.end())
+                continue;
+            if (event.mask & (IN_DELETE_SELF | IN_IGNORED))
+            {
+                // Directory itself is gone, nothing in it will be reported any more
+                changes.directories.push_back(it->second);
+                changes.lost = true;
+                directories.erase(it);
+                continue;
+            }
+            if (event.len > 0)
+                changes.files.push_back(fmt::format("{}/{}", it->second, name));
+            if (event.mask & LISTING_EVENTS)
+                changes.directories.push_back(it->second);
+        }
+    }
+    return changes;
+}
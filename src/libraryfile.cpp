@@ -0,0 +1,27 @@
+#include "libraryfile.h"
+
+bool LibraryFile::open(const std::string& path, const Archives& archives)
+{
+    content = {};
+    auto parts = ZipArchive::splitPath(path);
+    if (!parts)
+    {
+        if (!file.open(path))
+            return false;
+        content = file.bytes();
+        return true;
+    }
+
+    for (const auto& archive : archives)
+    {
+        if (archive->path() != parts->first)
+            continue;
+        const auto* entry = archive->find(parts->second);
+        auto bytes = entry ? archive->read(*entry, inflated) : std::nullopt;
+        if (!bytes)
+            return false;
+        content = *bytes;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,159 @@
+#include "localsocket.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <spdlog/spdlog.h>
+
+namespace {
+std::optional<sockaddr_un> socketAddress(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        spdlog::error("Socket path {} is too long", path);
+        return std::nullopt;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+} // namespace
+
+namespace LocalSocket {
+int listen(const std::string& path)
+{
+    auto address = socketAddress(path);
+    if (!address)
+        return -1;
+
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode))
+        {
+            spdlog::error("{} exists and is not a socket", path);
+            return -1;
+        }
+        // Socket file stays after server exits, it is stale if nobody accepts connections
+        if (auto fd = connect(path); fd >= 0)
+        {
+            close(fd);
+            spdlog::error("Another server is listening on {}", path);
+            return -1;
+        }
+        unlink(path.c_str());
+    }
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        spdlog::error("Cannot create socket: {}", std::strerror(errno));
+        return -1;
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) != 0 || ::listen(fd, 16) != 0)
+    {
+        spdlog::error("Cannot listen on {}: {}", path, std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connect(const std::string& path)
+{
+    auto address = socketAddress(path);
+    if (!address)
+        return -1;
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        spdlog::error("Cannot create socket: {}", std::strerror(errno));
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int accept(int listenFd)
+{
+    auto fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0 && errno != EINTR && errno != EAGAIN)
+        spdlog::error("Cannot accept connection: {}", std::strerror(errno));
+    return fd;
+}
+
+bool sendAll(int fd, std::string_view data)
+{
+    while (!data.empty())
+    {
+        auto written = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data.remove_prefix(written);
+    }
+    return true;
+}
+
+std::optional<std::string> receiveLine(int fd, int timeoutMs, size_t maxLength)
+{
+    std::string line;
+    char character;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        pollfd descriptor{.fd = fd, .events = POLLIN, .revents = 0};
+        auto ready = left.count() > 0 ? poll(&descriptor, 1, static_cast<int>(left.count())) : 0;
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+        {
+            spdlog::warn("No request received within {} ms", timeoutMs);
+            return std::nullopt;
+        }
+
+        auto length = recv(fd, &character, 1, 0);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0 || character == '\n')
+            break;
+        if (line.size() == maxLength)
+        {
+            spdlog::warn("Request longer than {} bytes", maxLength);
+            return std::nullopt;
+        }
+        line.push_back(character);
+    }
+    return line;
+}
+
+std::string receiveAll(int fd)
+{
+    std::string data;
+    char buffer[4096];
+    while (true)
+    {
+        auto length = recv(fd, buffer, sizeof(buffer), 0);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            break;
+        data.append(buffer, length);
+    }
+    return data;
+}
+} // namespace LocalSocket
@@ -0,0 +1,223 @@
+#include "pluginusage.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+
+#include "elffile.h"
+#include "libraryfile.h"
+#include "parallel.h"
+#include "textutils.h"
+#include "trace.h"
+
+namespace {
+constexpr std::string_view METADATA_SECTION = ".qtmetadata";
+constexpr std::string_view REQUIRED_TYPE = "platforms";
+constexpr size_t MIN_IID_LENGTH = 8;
+
+// Module without Qt prefix and version, e.g. Gui for Qt5Gui
+std::string moduleKey(std::string_view module)
+{
+    for (std::string_view prefix : {"Qt5", "Qt6", "Qt"})
+        if (module.starts_with(prefix))
+            return std::string(module.substr(prefix.size()));
+    return std::string(module);
+}
+
+std::string importKey(std::string_view import)
+{
+    if (import.starts_with("Qt"))
+        import.remove_prefix(2);
+    std::string key;
+    std::copy_if(import.begin(), import.end(), std::back_inserter(key),
+                 [](char character) { return character != '.'; });
+    return key;
+}
+
+// Loaded, non executable sections of library (string literals, symbol names), whole file without section headers
+std::vector<std::span<const std::byte>> searchedSections(const ElfFile& elf, std::span<const std::byte> image)
+{
+    std::vector<std::span<const std::byte>> ret;
+    auto sections = elf.sections();
+    for (const auto& section : sections)
+        if ((section.flags & Elf::SHF_ALLOC) && !(section.flags & Elf::SHF_EXECINSTR))
+            if (auto content = elf.sectionContent(section); !content.empty())
+                ret.push_back(content);
+    if (sections.empty())
+        ret.push_back(image);
+    return ret;
+}
+
+bool contains(std::span<const std::byte> bytes, std::string_view text)
+{
+    auto data = reinterpret_cast<const char*>(bytes.data());
+    return std::search(data, data + bytes.size(), std::boyer_moore_horspool_searcher(text.begin(), text.end())) !=
+           data + bytes.size();
+}
+} // namespace
+
+void PluginUsage::allow(std::string nameOrType)
+{
+    allowlist.insert(std::move(nameOrType));
+}
+
+void PluginUsage::addQmlDirectory(const std::string& directory)
+{
+    Trace::Scope scope("qml imports", directory);
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end;
+         it.increment(error))
+    {
+        if (it->path().extension() != ".qml")
+            continue;
+        std::ifstream file(it->path());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            // import QtQuick.Controls 2.15 [as Alias], directory imports are quoted
+            line = Text::trim(line);
+            if (!line.starts_with("import ") || line.size() <= 7)
+                continue;
+            auto module = Text::trim(line.substr(7));
+            module = module.substr(0, module.find_first_of(" \t;"));
+            if (!module.empty() && module.front() != '"')
+                qmlImports.insert(importKey(module));
+        }
+    }
+}
+
+std::vector<PluginUsage::Evidence> PluginUsage::evaluate(std::span<const Plugin> plugins,
+                                                         std::span<const std::string> applicationLibraries,
+                                                         unsigned jobs) const
+{
+    Trace::Scope scope("plugin usage");
+    std::vector<Evidence> evidence(plugins.size(), Evidence::None);
+    // Texts whose reference keeps plugin: class name and interface IIDs of plugin
+    std::map<std::string, std::vector<size_t>> referencedBy;
+    for (size_t index = 0; index < plugins.size(); ++index)
+    {
+        const auto& plugin = plugins[index];
+        if (plugin.type == REQUIRED_TYPE)
+            evidence[index] = Evidence::Required;
+        else if (allowlist.contains(plugin.className) || allowlist.contains(plugin.type))
+            evidence[index] = Evidence::Allowlist;
+        else if (isImportedFromQml(plugin.module))
+            evidence[index] = Evidence::QmlImport;
+        if (evidence[index] != Evidence::None)
+            continue;
+
+        referencedBy[plugin.className].push_back(index);
+        LibraryFile file;
+        if (file.open(plugin.path, {}))
+            for (auto& iid : interfaceIds(file.bytes()))
+                referencedBy[std::move(iid)].push_back(index);
+    }
+    if (referencedBy.empty())
+        return evidence;
+
+    std::vector<std::string_view> texts;
+    for (const auto& entry : referencedBy)
+        texts.push_back(entry.first);
+    std::vector<std::vector<char>> found(applicationLibraries.size());
+    Parallel::forEachIndex(applicationLibraries.size(), jobs, [&](size_t index) {
+        Trace::Scope librarySearch("plugin references", applicationLibraries[index]);
+        auto& libraryFound = found[index];
+        libraryFound.assign(texts.size(), false);
+        LibraryFile file;
+        if (!file.open(applicationLibraries[index], {}))
+            return;
+        ElfFile elf(file.bytes());
+        if (!elf.isValid())
+            return;
+        for (auto section : searchedSections(elf, file.bytes()))
+            for (size_t text = 0; text < texts.size(); ++text)
+                if (!libraryFound[text])
+                    libraryFound[text] = contains(section, texts[text]);
+    });
+
+    size_t text = 0;
+    for (const auto& entry : referencedBy)
+    {
+        bool referenced = std::any_of(found.cbegin(), found.cend(), [text](const auto& library) {
+            return !library.empty() && library[text];
+        });
+        if (referenced)
+            for (auto index : entry.second)
+                evidence[index] = Evidence::Reference;
+        ++text;
+    }
+    return evidence;
+}
+
+PluginUsage::Plugin PluginUsage::plugin(std::string_view module, std::string_view metadataName,
+                                        std::string_view relativePath, std::string path)
+{
+    auto className = metadataName;
+    if (className.starts_with(module) && className.size() > module.size() + 1)
+        className.remove_prefix(module.size() + 1);
+    return {.module = std::string(module),
+            .className = std::string(className),
+            .type = std::string(relativePath.substr(0, relativePath.find('/'))),
+            .path = std::move(path)};
+}
+
+std::vector<std::string> PluginUsage::interfaceIds(std::span<const std::byte> pluginImage)
+{
+    std::vector<std::string> ret;
+    ElfFile elf(pluginImage);
+    if (!elf.isValid())
+        return ret;
+    auto sections = elf.sections();
+    auto namesIndex = elf.sectionNamesIndex();
+    if (namesIndex >= sections.size())
+        return ret;
+    for (const auto& section : sections)
+    {
+        if (elf.sectionName(section, sections[namesIndex]) != METADATA_SECTION)
+            continue;
+        auto content = elf.sectionContent(section);
+        std::string_view text(reinterpret_cast<const char*>(content.data()), content.size());
+        for (size_t position = 0; position < text.size();)
+        {
+            auto end = position;
+            while (end < text.size() && text[end] > ' ' && text[end] < 0x7f)
+                ++end;
+            auto run = text.substr(position, end - position);
+            // CBOR text header is printable too: 0x60 + length, or 'x' and one byte length
+            if (!run.empty() && run[0] >= 0x60 && run[0] < 0x78 && static_cast<size_t>(run[0] - 0x60) == run.size() - 1)
+                run.remove_prefix(1);
+            else if (run.size() > 2 && run[0] == 'x' && static_cast<unsigned char>(run[1]) == run.size() - 2)
+                run.remove_prefix(2);
+            if (run.size() >= MIN_IID_LENGTH && run.find('.') != std::string_view::npos)
+                ret.emplace_back(run);
+            position = end + 1;
+        }
+    }
+    return ret;
+}
+
+const char* PluginUsage::evidenceName(Evidence evidence)
+{
+    switch (evidence)
+    {
+    case Evidence::Required:
+        return "required";
+    case Evidence::Allowlist:
+        return "allowlist";
+    case Evidence::Reference:
+        return "referenced by application";
+    case Evidence::QmlImport:
+        return "QML import";
+    default:
+        return "unused";
+    }
+}
+
+bool PluginUsage::isImportedFromQml(const std::string& module) const
+{
+    auto key = moduleKey(module);
+    return !key.empty() && std::any_of(qmlImports.cbegin(), qmlImports.cend(),
+                                       [&key](const auto& import) { return import.ends_with(key); });
+}
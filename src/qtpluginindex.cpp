@@ -0,0 +1,338 @@
+#include "qtpluginindex.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <optional>
+#include <spdlog/spdlog.h>
+
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+constexpr char INDEX_MAGIC[8] = {'D', 'S', 'Q', 'T', 'P', 'L', 'G', '\0'};
+constexpr uint32_t INDEX_VERSION = 1;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int64_t cmakeMtime;
+    uint32_t qtPathOffset;
+    uint32_t qtPathLength;
+    uint64_t moduleCount;
+    uint64_t pluginCount;
+    uint64_t stringsSize;
+};
+
+struct ModuleRecord
+{
+    int64_t mtime;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t pluginsBegin;
+    uint32_t pluginsCount;
+};
+
+struct PluginRecord
+{
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+struct IndexView
+{
+    Header header;
+    const ModuleRecord* modules;
+    const PluginRecord* plugins;
+    const char* strings;
+
+    explicit IndexView(std::span<const std::byte> bytes)
+    {
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        modules = reinterpret_cast<const ModuleRecord*>(bytes.data() + sizeof(Header));
+        plugins = reinterpret_cast<const PluginRecord*>(modules + header.moduleCount);
+        strings = reinterpret_cast<const char*>(plugins + header.pluginCount);
+    }
+
+    bool contains(uint32_t offset, uint32_t length) const
+    {
+        return offset + static_cast<uint64_t>(length) <= header.stringsSize;
+    }
+    std::string_view text(uint32_t offset, uint32_t length) const { return {strings + offset, length}; }
+};
+
+struct ModuleMetadata
+{
+    std::string name;
+    int64_t mtime = 0;
+    // Plugin name and release path
+    std::vector<std::pair<std::string, std::string>> plugins;
+};
+
+std::optional<int64_t> directoryMtime(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+        return std::nullopt;
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+// Path from "_populate_<Module>_plugin_properties(<Plugin> RELEASE "<path>" ...)" line
+std::string releasePath(const std::string& path)
+{
+    Trace::Scope scope("plugin metadata", path);
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.starts_with("_populate_"))
+            continue;
+
+        auto idx = line.find("RELEASE \"");
+        if (idx == std::string::npos)
+            break;
+
+        auto startIdx = idx + 9;
+        auto endIdx = line.find("\"", startIdx);
+        if (endIdx == std::string::npos || endIdx <= startIdx)
+            break;
+        return line.substr(startIdx, endIdx - startIdx);
+    }
+    return {};
+}
+
+void readModule(const std::string& cmakeDir, ModuleMetadata& module)
+{
+    auto directory = fmt::format("{}/{}", cmakeDir, module.name);
+    module.mtime = directoryMtime(directory).value_or(0);
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+    {
+        auto name = it->path().stem().string();
+        // <Module>_<Plugin>Plugin.cmake
+        if (it->path().extension() != ".cmake" || !name.starts_with(module.name) || !name.ends_with("Plugin") ||
+            name.length() == module.name.length() + 1 + 6)
+            continue;
+        module.plugins.emplace_back(name, releasePath(it->path()));
+    }
+    std::sort(module.plugins.begin(), module.plugins.end());
+}
+} // namespace
+
+QtPluginIndex::QtPluginIndex(std::string qtPath) : qt(std::move(qtPath))
+{
+}
+
+void QtPluginIndex::build(unsigned jobs)
+{
+    Trace::Scope scope("plugin index build", qt);
+    auto cmakeDir = fmt::format("{}/lib/cmake", qt);
+    auto cmakeMtime = directoryMtime(cmakeDir);
+    std::vector<ModuleMetadata> modules;
+    std::error_code error;
+    if (cmakeMtime)
+        for (std::filesystem::directory_iterator it(cmakeDir, error), end; !error && it != end; it.increment(error))
+            if (it->is_directory())
+                modules.push_back({.name = it->path().filename()});
+    std::sort(modules.begin(), modules.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+    Parallel::forEachIndex(modules.size(), jobs, [&](size_t index) { readModule(cmakeDir, modules[index]); });
+
+    std::vector<ModuleRecord> moduleRecords;
+    std::vector<PluginRecord> pluginRecords;
+    std::string strings;
+    auto addString = [&strings](std::string_view text) {
+        auto offset = static_cast<uint32_t>(strings.size());
+        strings.append(text);
+        return std::pair{offset, static_cast<uint32_t>(text.size())};
+    };
+
+    auto qtPath = addString(qt);
+    for (const auto& module : modules)
+    {
+        auto name = addString(module.name);
+        moduleRecords.push_back({.mtime = module.mtime,
+                                 .nameOffset = name.first,
+                                 .nameLength = name.second,
+                                 .pluginsBegin = static_cast<uint32_t>(pluginRecords.size()),
+                                 .pluginsCount = static_cast<uint32_t>(module.plugins.size())});
+        for (const auto& [pluginName, pluginPath] : module.plugins)
+        {
+            auto pluginNameReference = addString(pluginName);
+            auto pluginPathReference = addString(pluginPath);
+            pluginRecords.push_back({.nameOffset = pluginNameReference.first,
+                                     .nameLength = pluginNameReference.second,
+                                     .pathOffset = pluginPathReference.first,
+                                     .pathLength = pluginPathReference.second});
+        }
+    }
+
+    Header header{.version = INDEX_VERSION,
+                  .reserved = 0,
+                  .cmakeMtime = cmakeMtime.value_or(0),
+                  .qtPathOffset = qtPath.first,
+                  .qtPathLength = qtPath.second,
+                  .moduleCount = moduleRecords.size(),
+                  .pluginCount = pluginRecords.size(),
+                  .stringsSize = strings.size()};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+
+    mapping.close();
+    built.clear();
+    built.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    built.append(reinterpret_cast<const char*>(moduleRecords.data()), moduleRecords.size() * sizeof(ModuleRecord));
+    built.append(reinterpret_cast<const char*>(pluginRecords.data()), pluginRecords.size() * sizeof(PluginRecord));
+    built.append(strings);
+    indexBytes = {reinterpret_cast<const std::byte*>(built.data()), built.size()};
+}
+
+void QtPluginIndex::open(const std::string& indexPath, unsigned jobs)
+{
+    if (std::filesystem::exists(indexPath) && mapping.open(indexPath))
+    {
+        if (isValid(mapping.bytes()) && isCurrent(mapping.bytes()))
+        {
+            indexBytes = mapping.bytes();
+            return;
+        }
+        spdlog::info("Plugin index {} is out of date, rebuilding it", indexPath);
+    }
+
+    build(jobs);
+    auto temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(built.data(), built.size());
+        if (!file)
+        {
+            spdlog::warn("Cannot write plugin index {}", temporaryPath);
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, indexPath, error);
+    if (error)
+        spdlog::warn("Cannot replace plugin index {}: {}", indexPath, error.message());
+}
+
+bool QtPluginIndex::isValid(std::span<const std::byte> bytes) const
+{
+    if (bytes.size() < sizeof(Header))
+        return false;
+    IndexView view(bytes);
+    const auto& header = view.header;
+    auto expectedSize = sizeof(Header) + header.moduleCount * sizeof(ModuleRecord) +
+                        header.pluginCount * sizeof(PluginRecord) + header.stringsSize;
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+        expectedSize != bytes.size() || !view.contains(header.qtPathOffset, header.qtPathLength))
+        return false;
+
+    // Everything is checked once here, lookups do not need to
+    for (uint64_t index = 0; index < header.moduleCount; ++index)
+    {
+        const auto& module = view.modules[index];
+        if (!view.contains(module.nameOffset, module.nameLength) ||
+            module.pluginsBegin + static_cast<uint64_t>(module.pluginsCount) > header.pluginCount)
+            return false;
+    }
+    for (uint64_t index = 0; index < header.pluginCount; ++index)
+    {
+        const auto& plugin = view.plugins[index];
+        if (!view.contains(plugin.nameOffset, plugin.nameLength) ||
+            !view.contains(plugin.pathOffset, plugin.pathLength))
+            return false;
+    }
+    return true;
+}
+
+bool QtPluginIndex::isCurrent(std::span<const std::byte> bytes) const
+{
+    IndexView view(bytes);
+    if (view.text(view.header.qtPathOffset, view.header.qtPathLength) != qt)
+        return false;
+    auto cmakeDir = fmt::format("{}/lib/cmake", qt);
+    if (directoryMtime(cmakeDir).value_or(0) != view.header.cmakeMtime)
+        return false;
+    for (uint64_t index = 0; index < view.header.moduleCount; ++index)
+    {
+        const auto& module = view.modules[index];
+        auto directory = fmt::format("{}/{}", cmakeDir, view.text(module.nameOffset, module.nameLength));
+        if (directoryMtime(directory).value_or(0) != module.mtime)
+            return false;
+    }
+    return true;
+}
+
+std::vector<QtPluginIndex::Plugin> QtPluginIndex::plugins(std::string_view module) const
+{
+    std::vector<Plugin> ret;
+    if (indexBytes.empty())
+        return ret;
+    IndexView view(indexBytes);
+    auto end = view.modules + view.header.moduleCount;
+    auto it = std::lower_bound(view.modules, end, module, [&view](const ModuleRecord& record, std::string_view name) {
+        return view.text(record.nameOffset, record.nameLength) < name;
+    });
+    if (it == end || view.text(it->nameOffset, it->nameLength) != module)
+        return ret;
+    for (uint32_t index = 0; index < it->pluginsCount; ++index)
+    {
+        const auto& plugin = view.plugins[it->pluginsBegin + index];
+        ret.push_back({.name = view.text(plugin.nameOffset, plugin.nameLength),
+                       .path = view.text(plugin.pathOffset, plugin.pathLength)});
+    }
+    return ret;
+}
+
+std::vector<std::string> QtPluginIndex::metadataFiles() const
+{
+    std::vector<std::string> files;
+    if (indexBytes.empty())
+        return files;
+    auto cmakeDir = fmt::format("{}/lib/cmake", qt);
+    files.push_back(cmakeDir);
+    IndexView view(indexBytes);
+    for (uint64_t index = 0; index < view.header.moduleCount; ++index)
+    {
+        const auto& module = view.modules[index];
+        auto directory = fmt::format("{}/{}", cmakeDir, view.text(module.nameOffset, module.nameLength));
+        for (uint32_t plugin = 0; plugin < module.pluginsCount; ++plugin)
+        {
+            const auto& record = view.plugins[module.pluginsBegin + plugin];
+            files.push_back(fmt::format("{}/{}.cmake", directory, view.text(record.nameOffset, record.nameLength)));
+        }
+        files.push_back(std::move(directory));
+    }
+    return files;
+}
+
+std::string QtPluginIndex::pluginPath(const Plugin& plugin, const std::string& abi) const
+{
+    auto idx = plugin.path.find("${ANDROID_ABI}");
+    if (idx == std::string_view::npos)
+        return {};
+    return fmt::format("{}/plugins/{}{}{}", qt, plugin.path.substr(0, idx), abi, plugin.path.substr(idx + 14));
+}
+
+std::string QtPluginIndex::moduleName(const std::string& libraryName)
+{
+    auto it = std::find_if_not(libraryName.cbegin(), libraryName.cend(),
+                               [](auto character) { return std::isalnum(character); });
+    constexpr auto prefixLength = 3; // lib
+    return it == libraryName.cend()
+               ? libraryName
+               : libraryName.substr(prefixLength, std::distance(libraryName.cbegin(), it) - prefixLength);
+}
+
+size_t QtPluginIndex::moduleCount() const
+{
+    return indexBytes.empty() ? 0 : IndexView(indexBytes).header.moduleCount;
+}
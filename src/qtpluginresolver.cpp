@@ -1,4 +1,7 @@
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <string_view>
@@ -9,14 +12,25 @@
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include "abireusedependencyextractor.h"
 #include "androiddependencyextractor.h"
+#include "architecturerunner.h"
+#include "batchreadobjdependencyextractor.h"
+#include "cachingdependencyextractor.h"
+#include "deployer.h"
+#include "elfdependencyextractor.h"
+#include "entrypoints.h"
+#include "parallel.h"
+#include "pluginusage.h"
+#include "qtpluginindex.h"
+#include "trace.h"
 
 #include <CLI/CLI.hpp>
 
-std::unordered_map<std::string, std::string> ARCH_MAPPING{{"armeabi-v7a", "arm-linux-androideabi"},
-                                                          {"arm64-v8a", "aarch64-linux-android"},
-                                                          {"x86", "i686-linux-android"},
-                                                          {"x86_64", "x86_64-linux-android"}};
+const Architectures ARCH_MAPPING{{"armeabi-v7a", "arm-linux-androideabi"},
+                                {"arm64-v8a", "aarch64-linux-android"},
+                                {"x86", "i686-linux-android"},
+                                {"x86_64", "x86_64-linux-android"}};
 
 int main(int argc, char* argv[])
 {
@@ -25,9 +39,22 @@ int main(int argc, char* argv[])
     std::string appName;
     std::string ndkPath;
     std::string jsonFile;
+    std::string manifestFile;
     std::string toolchainPrefix = "llvm";
     std::string ndkHost = "linux-x86_64";
+    std::string backend = "elf";
+    unsigned jobs = Parallel::defaultJobs();
+    std::string cacheFile;
+    bool cacheByContent = false;
+    std::string traceFile;
+    bool printStats = false;
+    std::string logLevel = "debug";
     bool deployToAppDirectory = false;
+    std::string pluginIndexFile;
+    std::string referenceAbi;
+    bool prunePlugins = false;
+    std::set<std::string> keptPlugins;
+    std::set<std::string> qmlDirs;
     std::string qt;
     app.add_option("-d,--directory", appDirectory, "Build directory with subdirs (armeabi/arm64...)")
         ->check(CLI::ExistingDirectory);
@@ -35,11 +62,39 @@ int main(int argc, char* argv[])
     app.add_option("-n,--ndk", ndkPath, "Android NDK")->check(CLI::ExistingDirectory);
     app.add_option("-q,--qt", qt, "Qt install directory")->check(CLI::ExistingDirectory);
     app.add_option("-j,--json", jsonFile, "JSON with configuration")->check(CLI::ExistingFile);
-    app.add_flag("-c,--deploy", deployToAppDirectory, "Wheather to deploy missing libs");
+    app.add_option("-m,--manifest", manifestFile, "JSON with more applications/libraries resolved in one pass")
+        ->check(CLI::ExistingFile);
+    app.add_flag("-c,--deploy", deployToAppDirectory, "Deploy plugins into architecture subdirectories");
+    app.add_option("-b,--backend", backend,
+                   "Library scanner: elf (built-in), readobj (NDK llvm-readobj) or readobj-batch (many files per "
+                   "llvm-readobj process)")
+        ->check(CLI::IsMember({"elf", "readobj", "readobj-batch"}));
+    app.add_option("--jobs", jobs, "Number of libraries scanned in parallel")->check(CLI::PositiveNumber);
+    std::vector<std::string> abis;
+    for (const auto& arch : ARCH_MAPPING)
+        abis.push_back(arch.first);
+    app.add_option("--reference-abi", referenceAbi,
+                   "Resolve this architecture first, others reuse its scan results for libraries with the same "
+                   "needed libraries")
+        ->check(CLI::IsMember(abis));
+    app.add_option("--cache", cacheFile, "File with scan results reused between runs");
+    app.add_flag("--cache-hash", cacheByContent, "Validate cached scan results by content hash instead of mtime");
+    app.add_option("--trace", traceFile, "Write timings of all phases as Chrome trace-event JSON");
+    app.add_flag("--stats", printStats, "Print summary of timings and counters");
+    app.add_option("--log-level", logLevel, "Log level: trace, debug, info, warn, error or off")
+        ->check(CLI::IsMember({"trace", "debug", "info", "warn", "error", "off"}));
+    app.add_flag("--prune-plugins", prunePlugins,
+                 "Keep only plugins application uses (referenced class or IID, QML import of module, allowlist)");
+    app.add_option("--keep-plugin", keptPlugins, "Plugins (class name or type, e.g. imageformats) kept when pruning");
+    app.add_option("--qml-dir", qmlDirs, "Directories with QML files of application")->check(CLI::ExistingDirectory);
+    app.add_option("--plugin-index", pluginIndexFile,
+                   "File with index of Qt plugins, built on first use and rebuilt when Qt installation changes");
     CLI11_PARSE(app, argc, argv);
 
+    Trace::setEnabled(!traceFile.empty() || printStats);
     if (std::filesystem::exists(jsonFile))
     {
+        Trace::Scope scope("config load", jsonFile);
         using json = nlohmann::json;
         std::ifstream file(jsonFile);
         json data = json::parse(file);
@@ -59,144 +114,251 @@ int main(int argc, char* argv[])
             ndkHost = data["ndk-host"].get<std::string>();
         if (data.contains("qt"))
             qt = data["qt"].get<std::string>();
+        if (data.contains("qml-root-path"))
+            qmlDirs.insert(data["qml-root-path"].get<std::string>());
+        if (data.contains("plugin-allowlist"))
+            for (const auto& plugin : data["plugin-allowlist"])
+                keptPlugins.insert(plugin.get<std::string>());
     }
 
-    spdlog::set_level(spdlog::level::debug);
-    bool checkStatus = true;
-    
-    std::map<std::string, std::string> PLUGINS_INFO;
+    EntryPoints entries;
+    if (!entries.load(appName, manifestFile))
+        return 1;
 
-    for (const auto& arch : ARCH_MAPPING)
+    if (backend.starts_with("readobj") && ndkPath.empty())
     {
-        auto appDir = fmt::format("{}/{}", appDirectory, arch.first);
-        auto appPath = fmt::format("{}/lib{}_{}.so", appDir, appName, arch.first);
-        auto qtLibDir = fmt::format("{}/lib", qt);
-        if (!std::filesystem::exists(appPath))
-        {
-            spdlog::warn("Skipping arch {}, file {} does not exists", arch.first, appPath);
-            continue;
-        }
+        spdlog::error("Backend readobj requires NDK path");
+        return 1;
+    }
+    // Reuse reads the same dynamic section ELF backend would, it would only make other architectures wait
+    if (!referenceAbi.empty() && !backend.starts_with("readobj"))
+    {
+        spdlog::warn("--reference-abi is used only with readobj backends, ignored");
+        referenceAbi.clear();
+    }
 
-        SharedLibrary appMainLib{.name = appName, .path = appPath};
-        AndroidDependencyExtractor extractor(
-            AndroidDependencyExtractor::getToolPath(ndkPath, toolchainPrefix, ndkHost));
-        ExtractorOptions options{.libraryDirs = {appDir}, .scanDirs = {qtLibDir}, .systemDirs = {}};
-        options.preloadInfo(".so");
+    spdlog::set_level(spdlog::level::from_str(logLevel));
 
-        spdlog::info("Checking dependencies for architecture {}", arch.first);
-        auto result = extractor.resolveDependencies(appMainLib, options);
-
-        auto qtLibBaseName = [](const std::string& fullName) {
-            auto it = std::find_if_not(fullName.cbegin(), fullName.cend(),
-                                       [](auto character) { return std::isalnum(character); });
-            constexpr auto prefixLength = 3; // lib
-            return it == fullName.cend()
-                       ? fullName
-                       : fullName.substr(prefixLength, std::distance(fullName.cbegin(), it) - prefixLength);
-        };
-
-        auto readPluginInfo = [](const std::string& path) -> std::string {
-            std::string pluginSubPath;
-            std::ifstream file(path);
-            if (!file.is_open())
-                return pluginSubPath;
-            std::string line;
-            while (std::getline(file, line))
-            {
-                if (!line.starts_with("_populate_"))
-                    continue;
+    auto archJobs = std::max(1u, jobs / static_cast<unsigned>(ARCH_MAPPING.size()));
 
-                auto idx = line.find("RELEASE \"");
-                if (idx == std::string::npos)
-                    break;
+    std::unique_ptr<ScanCache> cache;
+    std::unique_ptr<DirectoryCache> directoryCache;
+    if (!cacheFile.empty())
+    {
+        directoryCache = std::make_unique<DirectoryCache>(cacheFile + ".dirs");
+        if (!directoryCache->load())
+            return 1;
+        cache = std::make_unique<ScanCache>(cacheFile, cacheByContent ? ScanCache::Validation::ContentHash
+                                                                       : ScanCache::Validation::FileIdentity);
+        if (!cache->load())
+            return 1;
+    }
 
-                auto startIdx = idx + 9;
-                auto endIdx = line.find("\"", startIdx);
+    QtPluginIndex pluginIndex(qt);
+    if (pluginIndexFile.empty())
+        pluginIndex.build(jobs);
+    else
+        pluginIndex.open(pluginIndexFile, jobs);
 
-                if (endIdx == std::string::npos || endIdx <= startIdx)
-                    break;
+    PluginUsage pluginUsage;
+    for (const auto& plugin : keptPlugins)
+        pluginUsage.allow(plugin);
+    if (prunePlugins)
+        for (const auto& directory : qmlDirs)
+            pluginUsage.addQmlDirectory(directory);
 
-                pluginSubPath = line.substr(startIdx, endIdx - startIdx);
-                break;
+    std::unique_ptr<AbiReuseDependencyExtractor::Reference> reference;
+    if (!referenceAbi.empty())
+        reference = std::make_unique<AbiReuseDependencyExtractor::Reference>();
+
+    Deployer deployer;
+    std::atomic<bool> deployStatus = true;
+    ArchitectureRunner runner(ARCH_MAPPING);
+    auto resolveArchitecture = [&](const std::string& abi, const std::string&, spdlog::logger& log) {
+        auto appDir = fmt::format("{}/{}", appDirectory, abi);
+        auto qtLibDir = fmt::format("{}/lib", qt);
+        std::vector<SharedLibrary> entryPoints;
+        for (const auto& name : entries.applications())
+        {
+            auto appPath = fmt::format("{}/lib{}_{}.so", appDir, name, abi);
+            if (!std::filesystem::exists(appPath))
+            {
+                log.warn("Skipping {} for arch {}, file {} does not exists", name, abi, appPath);
+                continue;
             }
-            file.close();
-            return pluginSubPath;
-        };
+            entryPoints.push_back({.name = name, .path = appPath});
+        }
+        auto libraries = entries.librariesOf(abi, log);
+        entryPoints.insert(entryPoints.end(), libraries.begin(), libraries.end());
+        if (entryPoints.empty())
+        {
+            log.warn("Skipping arch {}, nothing to check", abi);
+            return true;
+        }
 
-        auto qtPlugins = [qt](const std::string& libraryBaseName) -> std::set<std::string> {
-            std::set<std::string> pluginNamesInfo;
-            auto directory = fmt::format("{}/lib/cmake/{}", qt, libraryBaseName);
-            if (!std::filesystem::exists(directory))
-                return pluginNamesInfo;
+        std::unique_ptr<DependencyExtractor> extractor;
+        if (backend == "readobj")
+            extractor = std::make_unique<AndroidDependencyExtractor>(
+                AndroidDependencyExtractor::getToolPath(ndkPath, toolchainPrefix, ndkHost));
+        else if (backend == "readobj-batch")
+            extractor = std::make_unique<BatchReadobjDependencyExtractor>(
+                AndroidDependencyExtractor::getToolPath(ndkPath, toolchainPrefix, ndkHost));
+        else
+            extractor = std::make_unique<ElfDependencyExtractor>();
+        // Reference architecture records everything it gets (cache hits too), others compare with it before cache
+        AbiReuseDependencyExtractor* reuse = nullptr;
+        if (reference && abi != referenceAbi)
+        {
+            auto reuseExtractor =
+                std::make_unique<AbiReuseDependencyExtractor>(std::move(extractor), *reference, abi, false);
+            reuse = reuseExtractor.get();
+            extractor = std::move(reuseExtractor);
+        }
+        if (cache)
+            extractor = std::make_unique<CachingDependencyExtractor>(std::move(extractor), *cache);
+        if (reference && abi == referenceAbi)
+            extractor = std::make_unique<AbiReuseDependencyExtractor>(std::move(extractor), *reference, abi, true);
+        ExtractorOptions options{.libraryDirs = {appDir}, .scanDirs = {qtLibDir}, .systemDirs = {}};
+        options.jobs = archJobs;
+        options.directoryCache = directoryCache.get();
+        options.preloadInfo(".so");
 
-            for (const auto& item : std::filesystem::directory_iterator(directory))
-            {
-                const auto& ext = item.path().extension().string();
-                const auto& name = item.path().stem().string();
-                if (ext == ".cmake" && name.starts_with(libraryBaseName) && name.ends_with("Plugin"))
+        // Pruning needs libraries of every plugin, they are resolved as roots along with application
+        DependencyExtractor::RootExpansion expandPlugins;
+        if (prunePlugins)
+            expandPlugins = [&](const LibraryView& library) {
+                std::vector<SharedLibrary> ret;
+                if (!library.name().starts_with("libQt5"))
+                    return ret;
+                for (const auto& plugin : pluginIndex.plugins(QtPluginIndex::moduleName(std::string(library.name()))))
                 {
-                    auto prefixSize = libraryBaseName.length() + 1;
-                    auto length = name.length() - 6 - prefixSize;
-                    if (length <= 0)
-                        continue;
-                    pluginNamesInfo.insert(item.path());
+                    auto path = pluginIndex.pluginPath(plugin, abi);
+                    if (std::filesystem::is_regular_file(path))
+                        ret.push_back({.name = std::filesystem::path(path).filename(), .path = path});
                 }
+                return ret;
+            };
+
+        log.info("Checking dependencies for architecture {}", abi);
+        auto results = extractor->resolveBatch(entryPoints, options, expandPlugins);
+        std::map<std::string, std::string> qtLibs;
+        std::set<std::string> applicationLibraries;
+        for (size_t index = 0; index < entryPoints.size(); ++index)
+            for (const auto& lib : results[index].resolved)
+            {
+                if (lib.name().starts_with("libQt5"))
+                    qtLibs.emplace(lib.name(), lib.path());
+                if (lib.tier() == LibraryTier::Root || lib.tier() == LibraryTier::Library)
+                    applicationLibraries.emplace(lib.path());
             }
-            return pluginNamesInfo;
-        };
-
-        auto replaceArch = [](const std::string& subpath, const std::string& arch) -> std::string {
-            auto idx = subpath.find("${ANDROID_ABI}");
-            if (idx == std::string::npos)
-                return {};
-            auto result = subpath;
-            result.replace(idx, 14, arch);
-            return result;
-        };
-        
-        auto fullPluginPath = [qt](const std::string& subpath){
-            return fmt::format("{}/plugins/{}", qt, subpath);
-        };
-
-        for (const auto& val : result.resolved)
+        if (reuse)
+            log.info("Reused {} scan results of {}, {} libraries differ", reuse->reusedCount(), referenceAbi,
+                     reuse->differentCount());
+
+        std::vector<PluginUsage::Plugin> plugins;
+        for (const auto& [libName, libPath] : qtLibs)
         {
-            if (!val.first.starts_with("libQt5"))
-                continue;
-            auto baseName = qtLibBaseName(val.second.name);
-            auto allPlugins = qtPlugins(baseName);
+            auto baseName = QtPluginIndex::moduleName(libName);
+            auto allPlugins = pluginIndex.plugins(baseName);
             if(allPlugins.empty())
             {
-                spdlog::debug("No plugins for {} => {}", baseName, val.second.path);
+                log.debug("No plugins for {} => {}", baseName, libPath);
                 continue;
             }
             
-            spdlog::debug("Plugins for {} => {}", baseName, val.second.path);
+            log.debug("Plugins for {} => {}", baseName, libPath);
             for (const auto& plugin : allPlugins)
             {
-                std::string info;
-            
-                if(!PLUGINS_INFO.contains(plugin))
+                auto fullPath = pluginIndex.pluginPath(plugin, abi);
+                log.debug("===> {}", fullPath);
+                plugins.push_back(PluginUsage::plugin(baseName, plugin.name, plugin.path, fullPath));
+            }
+        }
+
+        std::vector<char> kept(plugins.size(), true);
+        if (prunePlugins)
+        {
+            std::vector<std::string> libraries(applicationLibraries.cbegin(), applicationLibraries.cend());
+            auto evidence = pluginUsage.evaluate(plugins, libraries, archJobs);
+            for (size_t index = 0; index < plugins.size(); ++index)
+            {
+                kept[index] = evidence[index] != PluginUsage::Evidence::None;
+                log.debug("{} {}: {}", kept[index] ? "Keeping" : "Pruning", plugins[index].className,
+                          PluginUsage::evidenceName(evidence[index]));
+            }
+
+            // Libraries loaded only because of pruned plugins. Plugins of Qt libraries loaded only by
+            // other plugins are resolved too, but they are not deployed, so they are left out.
+            std::map<std::string, bool> keptByPath;
+            for (size_t index = 0; index < plugins.size(); ++index)
+                keptByPath.emplace(plugins[index].path, kept[index]);
+            const auto& graph = *results.front().graph;
+            TransitiveClosures closures(graph);
+            std::vector<char> loadedAll(graph.size(), false);
+            std::vector<char> loadedKept(graph.size(), false);
+            for (size_t index = 0; index < results.size(); ++index)
+            {
+                bool rootKept = true;
+                if (index >= entryPoints.size())
                 {
-                    info = readPluginInfo(plugin);
-                    PLUGINS_INFO[plugin] = info;
+                    auto plugin = keptByPath.find(std::string(graph.path(results[index].root)));
+                    if (plugin == keptByPath.end())
+                        continue;
+                    rootKept = plugin->second;
                 }
-                else
-                    info = PLUGINS_INFO[plugin];
-                auto subpath = replaceArch(info, arch.first);
-                auto fullPath = fullPluginPath(subpath);
-                spdlog::debug("===> {}", fullPath);
-                if(deployToAppDirectory)
+                for (auto id : closures.closure(results[index].root))
                 {
-                    spdlog::debug("Copy {} => {}", fullPath, appDir);
-                    // SKIP for now
-//                    std::filesystem::copy_file(fullPath, appDir);
+                    loadedAll[id] = true;
+                    loadedKept[id] = loadedKept[id] || rootKept;
                 }
             }
+            size_t notLoaded = 0;
+            uint64_t bytesSaved = 0;
+            for (LibraryId id = 0; id < graph.size(); ++id)
+            {
+                if (!loadedAll[id] || loadedKept[id] || graph.tier(id) == LibraryTier::System)
+                    continue;
+                std::error_code error;
+                auto size = std::filesystem::file_size(std::string(graph.path(id)), error);
+                ++notLoaded;
+                bytesSaved += error ? 0 : size;
+            }
+            log.info("Pruned {} of {} plugins, {} libraries ({:.1f} KiB) fewer to deploy and load",
+                     std::count(kept.cbegin(), kept.cend(), false), plugins.size(), notLoaded, bytesSaved / 1024.0);
         }
+
+        if (deployToAppDirectory)
+        {
+            std::vector<std::string> deployed;
+            for (size_t index = 0; index < plugins.size(); ++index)
+                if (kept[index] && std::filesystem::is_regular_file(plugins[index].path))
+                    deployed.push_back(plugins[index].path);
+            log.info("Deploying {} plugins to {}", deployed.size(), appDir);
+            if (!deployer.deploy(deployed, appDir, archJobs))
+                deployStatus = false;
+        }
+        return true;
+    };
+    bool checkStatus = runner.run(resolveArchitecture, referenceAbi);
+
+    if (cache)
+    {
+        spdlog::info("Scan cache: {} hits, {} misses, directory listings: {} reused, {} read", cache->hits(),
+                     cache->misses(), directoryCache->hits(), directoryCache->misses());
+        Trace::Scope scope("scan cache save");
+        cache->save();
+        directoryCache->save();
     }
 
+    if (!traceFile.empty())
+        Trace::writeChromeTrace(traceFile);
+    if (printStats)
+        fmt::print("{}", Trace::summary());
+
     if (!checkStatus)
         spdlog::error("Check failed, missing at least one library!");
+    if (!deployStatus)
+        spdlog::error("Deploy failed for {} plugins", deployer.stats().failed);
 
     return 0;
 }
@@ -0,0 +1,309 @@
+#include "scancache.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <span>
+#include <spdlog/spdlog.h>
+
+#include "contenthash.h"
+
+namespace {
+constexpr char CACHE_MAGIC[8] = {'D', 'S', 'C', 'A', 'C', 'H', 'E', '\0'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t validation;
+    uint64_t recordCount;
+    uint64_t referenceCount;
+    uint64_t stringsSize;
+};
+
+struct Record
+{
+    uint64_t pathHash;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode;
+    uint64_t contentHash;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t sonameOffset;
+    uint32_t sonameLength;
+    uint32_t dependenciesBegin;
+    uint32_t dependenciesCount;
+};
+
+struct StringReference
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+uint64_t hashString(std::string_view text)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto character : text)
+    {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+} // namespace
+
+ScanCache::ScanCache(std::string path, Validation validation) : cachePath(std::move(path)), mode(validation)
+{
+}
+
+bool ScanCache::load()
+{
+    if (!std::filesystem::exists(cachePath))
+        return true;
+    if (!mapping.open(cachePath))
+    {
+        spdlog::error("Cannot open scan cache {}", cachePath);
+        return false;
+    }
+
+    auto bytes = mapping.bytes();
+    Header header;
+    bool valid = bytes.size() >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        auto expectedSize = sizeof(Header) + header.recordCount * sizeof(Record) +
+                            header.referenceCount * sizeof(StringReference) + header.stringsSize;
+        valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && header.version == CACHE_VERSION &&
+                expectedSize == bytes.size();
+    }
+    if (!valid)
+    {
+        spdlog::warn("Ignoring invalid scan cache {}", cachePath);
+        mapping.close();
+        return true;
+    }
+    if (header.validation != static_cast<uint32_t>(mode))
+    {
+        spdlog::info("Scan cache {} was created with other validation mode, ignoring it", cachePath);
+        mapping.close();
+    }
+    return true;
+}
+
+std::optional<ScanCache::Entry> ScanCache::mappedEntry(const std::string& path) const
+{
+    if (!mapping.isOpen())
+        return std::nullopt;
+
+    Header header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    auto records = reinterpret_cast<const Record*>(mapping.data() + sizeof(Header));
+    auto references = reinterpret_cast<const StringReference*>(records + header.recordCount);
+    auto strings = reinterpret_cast<const char*>(references + header.referenceCount);
+    auto text = [&](uint32_t offset, uint32_t length) {
+        return offset + static_cast<uint64_t>(length) <= header.stringsSize ? std::string_view(strings + offset, length)
+                                                                             : std::string_view();
+    };
+
+    auto pathHash = hashString(path);
+    auto end = records + header.recordCount;
+    auto record = std::lower_bound(records, end, pathHash,
+                                   [](const Record& entry, uint64_t hash) { return entry.pathHash < hash; });
+    for (; record != end && record->pathHash == pathHash; ++record)
+    {
+        if (text(record->pathOffset, record->pathLength) != path)
+            continue;
+        if (record->dependenciesBegin + static_cast<uint64_t>(record->dependenciesCount) > header.referenceCount)
+            return std::nullopt;
+
+        Entry entry{.key = {.size = record->size,
+                            .mtime = record->mtime,
+                            .inode = record->inode,
+                            .contentHash = record->contentHash},
+                    .soname = std::string(text(record->sonameOffset, record->sonameLength))};
+        for (uint32_t index = 0; index < record->dependenciesCount; ++index)
+        {
+            const auto& reference = references[record->dependenciesBegin + index];
+            entry.dependencies.emplace_back(text(reference.offset, reference.length));
+        }
+        return entry;
+    }
+    return std::nullopt;
+}
+
+std::optional<ScanCache::FileKey> ScanCache::fileKey(const std::string& path) const
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return std::nullopt;
+
+    FileKey key{.size = static_cast<uint64_t>(info.st_size)};
+    if (mode == Validation::FileIdentity)
+    {
+        key.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        key.inode = info.st_ino;
+        return key;
+    }
+
+    MappedFile file;
+    if (!file.open(path))
+        return std::nullopt;
+    key.contentHash = contentHash(file.bytes());
+    return key;
+}
+
+bool ScanCache::lookup(SharedLibrary& target)
+{
+    if (auto key = fileKey(target.path))
+    {
+        std::optional<Entry> entry;
+        bool stale = false;
+        {
+            std::lock_guard lock(mutex);
+            if (auto it = updated.find(target.path); it != updated.end())
+                entry = it->second;
+            else
+                stale = invalidated.contains(target.path);
+        }
+        if (!entry && !stale)
+            entry = mappedEntry(target.path);
+
+        if (entry && entry->key == *key)
+        {
+            target.dependencies.insert(entry->dependencies.begin(), entry->dependencies.end());
+            target.soname = entry->soname;
+            target.scanned = true;
+            ++hitCount;
+            return true;
+        }
+    }
+    ++missCount;
+    return false;
+}
+
+void ScanCache::store(const SharedLibrary& target)
+{
+    if (!target.scanned)
+        return;
+    auto key = fileKey(target.path);
+    if (!key)
+        return;
+
+    Entry entry{.key = *key,
+                .soname = target.soname,
+                .dependencies = {target.dependencies.begin(), target.dependencies.end()}};
+    std::lock_guard lock(mutex);
+    updated.insert_or_assign(target.path, std::move(entry));
+    invalidated.erase(target.path);
+}
+
+void ScanCache::invalidate(const std::string& path)
+{
+    std::lock_guard lock(mutex);
+    updated.erase(path);
+    invalidated.insert(path);
+}
+
+bool ScanCache::save()
+{
+    std::lock_guard lock(mutex);
+    if (updated.empty() && invalidated.empty())
+        return true;
+
+    std::map<std::pair<uint64_t, std::string>, Entry> entries;
+    if (mapping.isOpen())
+    {
+        Header header;
+        std::memcpy(&header, mapping.data(), sizeof(header));
+        auto records = reinterpret_cast<const Record*>(mapping.data() + sizeof(Header));
+        auto strings = reinterpret_cast<const char*>(mapping.data() + sizeof(Header) +
+                                                     header.recordCount * sizeof(Record) +
+                                                     header.referenceCount * sizeof(StringReference));
+        for (uint64_t index = 0; index < header.recordCount; ++index)
+        {
+            const auto& record = records[index];
+            if (record.pathOffset + static_cast<uint64_t>(record.pathLength) > header.stringsSize)
+                continue;
+            std::string path(strings + record.pathOffset, record.pathLength);
+            if (updated.contains(path) || invalidated.contains(path))
+                continue;
+            if (auto entry = mappedEntry(path))
+                entries.insert({{record.pathHash, path}, std::move(*entry)});
+        }
+    }
+    for (const auto& [path, entry] : updated)
+        entries.insert_or_assign({hashString(path), path}, entry);
+
+    std::vector<Record> records;
+    std::vector<StringReference> references;
+    std::string strings;
+    auto addString = [&strings](std::string_view text) {
+        StringReference reference{.offset = static_cast<uint32_t>(strings.size()),
+                                  .length = static_cast<uint32_t>(text.size())};
+        strings.append(text);
+        return reference;
+    };
+
+    records.reserve(entries.size());
+    for (const auto& [id, entry] : entries)
+    {
+        auto path = addString(id.second);
+        auto soname = addString(entry.soname);
+        Record record{.pathHash = id.first,
+                      .size = entry.key.size,
+                      .mtime = entry.key.mtime,
+                      .inode = entry.key.inode,
+                      .contentHash = entry.key.contentHash,
+                      .pathOffset = path.offset,
+                      .pathLength = path.length,
+                      .sonameOffset = soname.offset,
+                      .sonameLength = soname.length,
+                      .dependenciesBegin = static_cast<uint32_t>(references.size()),
+                      .dependenciesCount = static_cast<uint32_t>(entry.dependencies.size())};
+        for (const auto& dependency : entry.dependencies)
+            references.push_back(addString(dependency));
+        records.push_back(record);
+    }
+
+    Header header{.version = CACHE_VERSION,
+                  .validation = static_cast<uint32_t>(mode),
+                  .recordCount = records.size(),
+                  .referenceCount = references.size(),
+                  .stringsSize = strings.size()};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+
+    auto temporaryPath = cachePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            spdlog::error("Cannot write scan cache {}", temporaryPath);
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        file.write(reinterpret_cast<const char*>(references.data()), references.size() * sizeof(StringReference));
+        file.write(strings.data(), strings.size());
+        if (!file)
+        {
+            spdlog::error("Cannot write scan cache {}", temporaryPath);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    if (error)
+    {
+        spdlog::error("Cannot replace scan cache {}: {}", cachePath, error.message());
+        return false;
+    }
+    return true;
+}
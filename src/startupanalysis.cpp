@@ -0,0 +1,116 @@
+#include "startupanalysis.h"
+
+#include <deque>
+#include <utility>
+
+#include "elffile.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+bool isLoaded(const DependencyGraph& graph, LibraryId id)
+{
+    return graph.tier(id) != LibraryTier::System;
+}
+} // namespace
+
+StartupAnalysis::Cost& StartupAnalysis::Cost::operator+=(const Cost& other)
+{
+    libraries += other.libraries;
+    fileSize += other.fileSize;
+    relocations += other.relocations;
+    pltRelocations += other.pltRelocations;
+    symbols += other.symbols;
+    initFunctions += other.initFunctions;
+    return *this;
+}
+
+void StartupAnalysis::addArchive(std::shared_ptr<const ZipArchive> archive)
+{
+    archives.push_back(std::move(archive));
+}
+
+std::vector<StartupAnalysis::Report> StartupAnalysis::analyze(const DependencyGraph& graph,
+                                                              std::span<const LibraryId> roots, unsigned jobs)
+{
+    Trace::Scope scope("startup analysis");
+    TransitiveClosures closures(graph);
+    std::vector<char> needed(graph.size(), false);
+    for (auto root : roots)
+        for (auto id : closures.closure(root))
+            needed[id] = isLoaded(graph, id);
+    std::vector<LibraryId> toRead;
+    for (LibraryId id = 0; id < graph.size(); ++id)
+        if (needed[id])
+            toRead.push_back(id);
+
+    // Dependencies are taken from file again, graph does not keep DT_NEEDED order
+    std::vector<LibraryCost> costs(graph.size());
+    std::vector<std::vector<LibraryId>> loads(graph.size());
+    Parallel::forEachIndex(toRead.size(), jobs, [&](size_t index) {
+        auto id = toRead[index];
+        auto& libraryCost = costs[id];
+        libraryCost.library = id;
+        LibraryFile file;
+        if (!file.open(std::string(graph.path(id)), archives))
+            return;
+        ElfFile elf(file.bytes());
+        if (!elf.isValid())
+            return;
+        auto loadCost = elf.loadCost();
+        libraryCost.readable = true;
+        libraryCost.cost = {.libraries = 1,
+                            .fileSize = file.bytes().size(),
+                            .relocations = loadCost.relocations,
+                            .pltRelocations = loadCost.pltRelocations,
+                            .symbols = elf.dynamicSymbolCount(),
+                            .initFunctions = loadCost.initFunctions};
+        for (auto name : elf.neededLibraries())
+            if (auto dependency = graph.find(name); dependency && isLoaded(graph, *dependency))
+                loads[id].push_back(*dependency);
+    });
+    for (auto id : toRead)
+        if (!costs[id].readable)
+            for (auto dependency : graph.dependencies(id))
+                if (isLoaded(graph, dependency))
+                    loads[id].push_back(dependency);
+
+    std::vector<Report> reports;
+    for (auto root : roots)
+    {
+        auto& report = reports.emplace_back(Report{.root = root});
+        std::vector<char> visited(graph.size(), false);
+        std::deque<LibraryId> queue{root};
+        visited[root] = true;
+        while (!queue.empty())
+        {
+            auto id = queue.front();
+            queue.pop_front();
+            report.loadOrder.push_back(costs[id]);
+            report.loadOrder.back().library = id;
+            report.total += costs[id].cost;
+            for (auto dependency : loads[id])
+                if (!std::exchange(visited[dependency], true))
+                    queue.push_back(dependency);
+        }
+
+        // Library reachable from only one direct dependency is loaded because of it
+        std::vector<uint32_t> reachedBy(graph.size(), 0);
+        for (auto dependency : loads[root])
+            for (auto id : closures.closure(dependency))
+                ++reachedBy[id];
+        for (auto dependency : loads[root])
+        {
+            auto& dependencyCost = report.dependencies.emplace_back(DependencyCost{.dependency = dependency});
+            for (auto id : closures.closure(dependency))
+            {
+                if (id == root || !isLoaded(graph, id))
+                    continue;
+                dependencyCost.total += costs[id].cost;
+                if (reachedBy[id] == 1)
+                    dependencyCost.exclusive += costs[id].cost;
+            }
+        }
+    }
+    return reports;
+}
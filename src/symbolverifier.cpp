@@ -0,0 +1,215 @@
+#include "symbolverifier.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "elffile.h"
+#include "libraryfile.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+struct LoadedLibrary
+{
+    LibraryFile file;
+    std::optional<ElfFile> elf;
+};
+
+// Reads libraries marked in needed in parallel, others stay null. Symbol tables
+// are located here, as loaded libraries are then shared by workers.
+std::vector<std::unique_ptr<LoadedLibrary>> loadLibraries(const DependencyGraph& graph, const std::vector<char>& needed,
+                                                          const Archives& archives, unsigned jobs)
+{
+    std::vector<LibraryId> toLoad;
+    for (LibraryId id = 0; id < graph.size(); ++id)
+        if (needed[id])
+            toLoad.push_back(id);
+    std::vector<std::unique_ptr<LoadedLibrary>> loaded(graph.size());
+    Parallel::forEachIndex(toLoad.size(), jobs, [&](size_t index) {
+        auto id = toLoad[index];
+        auto library = std::make_unique<LoadedLibrary>();
+        if (library->file.open(std::string(graph.path(id)), archives))
+        {
+            if (auto& elf = library->elf.emplace(library->file.bytes()); !elf.isValid())
+                library->elf.reset();
+            else
+                elf.dynamicSymbolCount();
+        }
+        loaded[id] = std::move(library);
+    });
+    return loaded;
+}
+
+bool isChecked(LibraryTier tier)
+{
+    return tier == LibraryTier::Root || tier == LibraryTier::Library || tier == LibraryTier::Scan;
+}
+
+// Marks libraries reachable from roots, skipping edges for which skip(library, dependency) is true
+template <typename Skip>
+std::vector<char> reachable(const DependencyGraph& graph, std::span<const LibraryId> roots, Skip&& skip)
+{
+    std::vector<char> visited(graph.size(), false);
+    std::vector<LibraryId> stack;
+    for (auto root : roots)
+        if (!std::exchange(visited[root], true))
+            stack.push_back(root);
+    while (!stack.empty())
+    {
+        auto id = stack.back();
+        stack.pop_back();
+        for (auto dependency : graph.dependencies(id))
+            if (!visited[dependency] && !skip(id, dependency))
+            {
+                visited[dependency] = true;
+                stack.push_back(dependency);
+            }
+    }
+    return visited;
+}
+} // namespace
+
+void SymbolVerifier::addArchive(std::shared_ptr<const ZipArchive> archive)
+{
+    archives.push_back(std::move(archive));
+}
+
+std::vector<SymbolVerifier::Unresolved> SymbolVerifier::verify(const DependencyGraph& graph,
+                                                               std::span<const LibraryId> libraries, unsigned jobs)
+{
+    Trace::Scope scope("verify symbols");
+    TransitiveClosures closures(graph);
+    std::vector<LibraryId> targets;
+    std::vector<std::vector<LibraryId>> providers;
+    std::vector<char> needed(graph.size(), false);
+    for (auto id : libraries)
+    {
+        if (!isChecked(graph.tier(id)))
+            continue;
+        targets.push_back(id);
+        auto& libraryProviders = providers.emplace_back();
+        for (auto provider : closures.closure(id))
+        {
+            needed[provider] = true;
+            if (provider != id)
+                libraryProviders.push_back(provider);
+        }
+    }
+
+    auto loaded = loadLibraries(graph, needed, archives, jobs);
+    std::vector<Unresolved> results(targets.size());
+    std::vector<char> checked(targets.size(), false);
+    Parallel::forEachIndex(targets.size(), jobs, [&](size_t index) {
+        results[index].library = targets[index];
+        const auto& self = loaded[targets[index]]->elf;
+        if (!self)
+            return;
+        std::vector<const ElfFile*> exporters;
+        for (auto provider : providers[index])
+        {
+            if (!loaded[provider]->elf)
+                return;
+            exporters.push_back(&*loaded[provider]->elf);
+        }
+
+        Trace::Scope librarySymbols("verify library", graph.name(targets[index]));
+        for (size_t symbolIndex = 0; symbolIndex < self->dynamicSymbolCount(); ++symbolIndex)
+        {
+            // Weak undefined symbols may stay unresolved
+            auto symbol = self->dynamicSymbol(symbolIndex);
+            if (symbol.isDefined() || symbol.binding != Elf::STB_GLOBAL || symbol.name.empty())
+                continue;
+            auto hash = ElfFile::gnuHash(symbol.name);
+            bool found = false;
+            for (auto exporter : exporters)
+                if ((found = exporter->exportsSymbol(symbol.name, hash)))
+                    break;
+            if (!found)
+                results[index].symbols.emplace_back(symbol.name);
+        }
+        checked[index] = true;
+    });
+
+    std::vector<Unresolved> unresolved;
+    for (size_t index = 0; index < targets.size(); ++index)
+    {
+        if (!checked[index])
+        {
+            ++skipped;
+            continue;
+        }
+        ++verified;
+        if (!results[index].symbols.empty())
+            unresolved.push_back(std::move(results[index]));
+    }
+    return unresolved;
+}
+
+std::vector<SymbolVerifier::UnusedDependency> SymbolVerifier::findUnusedDependencies(
+    const DependencyGraph& graph, std::span<const LibraryId> libraries, unsigned jobs)
+{
+    Trace::Scope scope("unused dependencies");
+    std::vector<LibraryId> targets;
+    std::vector<char> needed(graph.size(), false);
+    for (auto id : libraries)
+    {
+        if (!isChecked(graph.tier(id)))
+            continue;
+        targets.push_back(id);
+        needed[id] = true;
+        for (auto dependency : graph.dependencies(id))
+            needed[dependency] = true;
+    }
+    auto loaded = loadLibraries(graph, needed, archives, jobs);
+
+    std::vector<std::vector<UnusedDependency>> results(targets.size());
+    Parallel::forEachIndex(targets.size(), jobs, [&](size_t index) {
+        auto id = targets[index];
+        const auto& self = loaded[id]->elf;
+        if (!self)
+            return;
+        // Weak references count too, dependency satisfying them is used
+        std::vector<std::pair<std::string_view, uint32_t>> imports;
+        for (size_t symbolIndex = 0; symbolIndex < self->dynamicSymbolCount(); ++symbolIndex)
+        {
+            auto symbol = self->dynamicSymbol(symbolIndex);
+            if (!symbol.isDefined() && !symbol.name.empty() && symbol.binding != Elf::STB_LOCAL)
+                imports.emplace_back(symbol.name, ElfFile::gnuHash(symbol.name));
+        }
+        for (auto dependency : graph.dependencies(id))
+        {
+            // Exports of dependency that cannot be read are unknown
+            const auto& exporter = loaded[dependency]->elf;
+            if (!exporter)
+                continue;
+            bool used = std::any_of(imports.cbegin(), imports.cend(), [&](const auto& import) {
+                return exporter->exportsSymbol(import.first, import.second);
+            });
+            if (!used)
+                results[index].push_back({.library = id, .dependency = dependency});
+        }
+    });
+
+    std::vector<UnusedDependency> unused;
+    for (auto& result : results)
+        unused.insert(unused.end(), result.begin(), result.end());
+    return unused;
+}
+
+std::vector<LibraryId> SymbolVerifier::droppedLibraries(const DependencyGraph& graph, std::span<const LibraryId> roots,
+                                                        std::span<const UnusedDependency> removed)
+{
+    auto before = reachable(graph, roots, [](LibraryId, LibraryId) { return false; });
+    auto after = reachable(graph, roots, [&](LibraryId library, LibraryId dependency) {
+        return std::any_of(removed.begin(), removed.end(), [&](const auto& edge) {
+            return edge.library == library && edge.dependency == dependency;
+        });
+    });
+    std::vector<LibraryId> dropped;
+    for (LibraryId id = 0; id < graph.size(); ++id)
+        if (before[id] && !after[id])
+            dropped.push_back(id);
+    return dropped;
+}
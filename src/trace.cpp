@@ -0,0 +1,184 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+namespace {
+struct Event
+{
+    const char* name;
+    std::string detail;
+    uint64_t start;
+    uint64_t duration;
+    int64_t value;
+    bool isCounter;
+};
+
+struct ThreadBuffer
+{
+    uint32_t threadId;
+    std::vector<Event> events;
+};
+
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+const uint64_t traceStart = Trace::now();
+
+ThreadBuffer& threadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard lock(buffersMutex);
+        buffer = buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+        buffer->threadId = static_cast<uint32_t>(buffers.size());
+    }
+    return *buffer;
+}
+
+std::string escape(std::string_view text)
+{
+    std::string ret;
+    ret.reserve(text.size());
+    for (auto character : text)
+    {
+        switch (character)
+        {
+        case '"':
+            ret += "\\\"";
+            break;
+        case '\\':
+            ret += "\\\\";
+            break;
+        case '\n':
+            ret += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(character) < 0x20)
+                ret += fmt::format("\\u{:04x}", static_cast<int>(character));
+            else
+                ret += character;
+        }
+    }
+    return ret;
+}
+} // namespace
+
+std::atomic<bool> Trace::detail::active = false;
+
+void Trace::setEnabled(bool enabled)
+{
+    detail::active = enabled;
+}
+
+uint64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Events are only appended by the owning thread, readers run after work is done
+void Trace::detail::complete(const char* name, std::string_view detail, uint64_t start, uint64_t end)
+{
+    threadBuffer().events.push_back(
+        {.name = name, .detail = std::string(detail), .start = start, .duration = end - start, .isCounter = false});
+}
+
+void Trace::detail::counter(const char* name, int64_t value)
+{
+    threadBuffer().events.push_back({.name = name, .start = now(), .value = value, .isCounter = true});
+}
+
+bool Trace::writeChromeTrace(const std::string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        spdlog::error("Cannot write trace {}", path);
+        return false;
+    }
+
+    std::lock_guard lock(buffersMutex);
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : buffers)
+        for (const auto& event : buffer->events)
+        {
+            auto timestamp = static_cast<double>(event.start - std::min(event.start, traceStart)) / 1000.0;
+            file << (first ? "\n" : ",\n");
+            first = false;
+            if (event.isCounter)
+                file << fmt::format(R"({{"name":"{}","ph":"C","ts":{:.3f},"pid":1,"tid":{},"args":{{"value":{}}}}})",
+                                    escape(event.name), timestamp, buffer->threadId, event.value);
+            else
+                file << fmt::format(
+                    R"({{"name":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{},"args":{{"detail":"{}"}}}})",
+                    escape(event.name), timestamp, static_cast<double>(event.duration) / 1000.0, buffer->threadId,
+                    escape(event.detail));
+        }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+std::string Trace::summary()
+{
+    struct Span
+    {
+        size_t count = 0;
+        uint64_t total = 0;
+        uint64_t max = 0;
+    };
+    struct Counter
+    {
+        size_t samples = 0;
+        int64_t max = 0;
+        int64_t last = 0;
+        uint64_t lastTime = 0;
+    };
+
+    std::map<std::string, Span> spans;
+    std::map<std::string, Counter> counters;
+    {
+        std::lock_guard lock(buffersMutex);
+        for (const auto& buffer : buffers)
+            for (const auto& event : buffer->events)
+            {
+                if (event.isCounter)
+                {
+                    auto& counter = counters[event.name];
+                    counter.max = counter.samples ? std::max(counter.max, event.value) : event.value;
+                    ++counter.samples;
+                    if (event.start >= counter.lastTime)
+                    {
+                        counter.last = event.value;
+                        counter.lastTime = event.start;
+                    }
+                    continue;
+                }
+                auto& span = spans[event.name];
+                ++span.count;
+                span.total += event.duration;
+                span.max = std::max(span.max, event.duration);
+            }
+    }
+
+    std::string ret = fmt::format("{:<28} {:>8} {:>12} {:>12} {:>12}\n", "span", "count", "total [ms]", "avg [ms]",
+                                  "max [ms]");
+    for (const auto& [name, span] : spans)
+        ret += fmt::format("{:<28} {:>8} {:>12.3f} {:>12.3f} {:>12.3f}\n", name, span.count, span.total / 1e6,
+                           span.total / 1e6 / span.count, span.max / 1e6);
+    if (!counters.empty())
+    {
+        ret += fmt::format("{:<28} {:>8} {:>12} {:>12}\n", "counter", "samples", "max", "last");
+        for (const auto& [name, counter] : counters)
+            ret += fmt::format("{:<28} {:>8} {:>12} {:>12}\n", name, counter.samples, counter.max, counter.last);
+    }
+    return ret;
+}
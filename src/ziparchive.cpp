@@ -0,0 +1,207 @@
+#include "ziparchive.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "trace.h"
+
+namespace {
+constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr uint32_t END_SIGNATURE = 0x06054b50;
+constexpr uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+constexpr uint16_t METHOD_STORED = 0;
+constexpr uint16_t METHOD_DEFLATED = 8;
+constexpr uint16_t FLAG_ENCRYPTED = 0x0001;
+constexpr size_t END_SIZE = 22;
+constexpr size_t LOCAL_HEADER_SIZE = 30;
+constexpr size_t CENTRAL_HEADER_SIZE = 46;
+constexpr size_t MAX_COMMENT_SIZE = 0xffff;
+
+// Little endian integer at offset, 0 when it is out of bytes
+uint64_t readInteger(std::span<const std::byte> bytes, uint64_t offset, size_t size)
+{
+    if (offset > bytes.size() || size > bytes.size() - offset)
+        return 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i)
+        value |= static_cast<uint64_t>(bytes[offset + i]) << (8 * i);
+    return value;
+}
+} // namespace
+
+bool ZipArchive::open(const std::string& path)
+{
+    Trace::Scope scope("archive open", path);
+    archivePath = path;
+    errorMessage.clear();
+    entryList.clear();
+    if (!file.open(path))
+        return fail("cannot open file");
+
+    auto bytes = file.bytes();
+    if (bytes.size() < END_SIZE)
+        return fail("not a ZIP archive");
+    // End record is followed only by archive comment
+    auto lowest = bytes.size() - END_SIZE - std::min(bytes.size() - END_SIZE, MAX_COMMENT_SIZE);
+    for (auto end = bytes.size() - END_SIZE + 1; end-- > lowest;)
+    {
+        if (readInteger(bytes, end, 4) != END_SIGNATURE)
+            continue;
+        uint64_t count = readInteger(bytes, end + 10, 2);
+        uint64_t size = readInteger(bytes, end + 12, 4);
+        uint64_t offset = readInteger(bytes, end + 16, 4);
+        if (count == 0xffff || size == 0xffffffff || offset == 0xffffffff)
+        {
+            auto locator = end >= 20 ? end - 20 : bytes.size();
+            if (readInteger(bytes, locator, 4) != ZIP64_LOCATOR_SIGNATURE)
+                return fail("missing ZIP64 end of central directory");
+            auto zip64End = readInteger(bytes, locator + 8, 8);
+            if (readInteger(bytes, zip64End, 4) != ZIP64_END_SIGNATURE)
+                return fail("invalid ZIP64 end of central directory");
+            count = readInteger(bytes, zip64End + 32, 8);
+            size = readInteger(bytes, zip64End + 40, 8);
+            offset = readInteger(bytes, zip64End + 48, 8);
+        }
+        return readCentralDirectory(offset, size, count);
+    }
+    return fail("not a ZIP archive");
+}
+
+bool ZipArchive::readCentralDirectory(uint64_t offset, uint64_t size, uint64_t count)
+{
+    auto bytes = file.bytes();
+    if (offset > bytes.size() || size > bytes.size() - offset || count > size / CENTRAL_HEADER_SIZE)
+        return fail("invalid central directory");
+
+    entryList.reserve(count);
+    auto position = offset;
+    for (uint64_t index = 0; index < count; ++index)
+    {
+        if (position + CENTRAL_HEADER_SIZE > offset + size ||
+            readInteger(bytes, position, 4) != CENTRAL_HEADER_SIGNATURE)
+            return fail("invalid central directory entry");
+        auto nameLength = readInteger(bytes, position + 28, 2);
+        auto extraLength = readInteger(bytes, position + 30, 2);
+        auto commentLength = readInteger(bytes, position + 32, 2);
+        auto nameOffset = position + CENTRAL_HEADER_SIZE;
+        auto next = nameOffset + nameLength + extraLength + commentLength;
+        if (next > offset + size)
+            return fail("truncated central directory entry");
+
+        Entry entry{.name = {reinterpret_cast<const char*>(bytes.data() + nameOffset), nameLength},
+                    .method = static_cast<uint16_t>(readInteger(bytes, position + 10, 2)),
+                    .compressedSize = readInteger(bytes, position + 20, 4),
+                    .size = readInteger(bytes, position + 24, 4),
+                    .localHeaderOffset = readInteger(bytes, position + 42, 4)};
+        if (readInteger(bytes, position + 8, 2) & FLAG_ENCRYPTED)
+            entry.method = UINT16_MAX;
+
+        // ZIP64 extra field has only values that did not fit, in this order
+        for (auto extra = nameOffset + nameLength; extra + 4 <= nameOffset + nameLength + extraLength;)
+        {
+            auto id = readInteger(bytes, extra, 2);
+            auto length = readInteger(bytes, extra + 2, 2);
+            if (id == ZIP64_EXTRA_ID)
+            {
+                auto value = extra + 4;
+                for (auto* field : {&entry.size, &entry.compressedSize, &entry.localHeaderOffset})
+                    if (*field == 0xffffffff && value + 8 <= extra + 4 + length)
+                    {
+                        *field = readInteger(bytes, value, 8);
+                        value += 8;
+                    }
+            }
+            extra += 4 + length;
+        }
+        entryList.push_back(entry);
+        position = next;
+    }
+
+    std::sort(entryList.begin(), entryList.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+    return true;
+}
+
+const ZipArchive::Entry* ZipArchive::find(std::string_view name) const
+{
+    auto it = std::lower_bound(entryList.cbegin(), entryList.cend(), name,
+                               [](const Entry& entry, std::string_view value) { return entry.name < value; });
+    return it != entryList.cend() && it->name == name ? &*it : nullptr;
+}
+
+std::optional<std::span<const std::byte>> ZipArchive::read(const Entry& entry, std::vector<std::byte>& buffer) const
+{
+    auto bytes = file.bytes();
+    auto header = entry.localHeaderOffset;
+    if (readInteger(bytes, header, 4) != LOCAL_HEADER_SIGNATURE)
+        return std::nullopt;
+    // Local header has its own extra field, e.g. alignment padding of stored entries
+    auto dataOffset =
+        header + LOCAL_HEADER_SIZE + readInteger(bytes, header + 26, 2) + readInteger(bytes, header + 28, 2);
+    if (dataOffset > bytes.size() || entry.compressedSize > bytes.size() - dataOffset)
+        return std::nullopt;
+    auto compressed = bytes.subspan(dataOffset, entry.compressedSize);
+
+    if (entry.method == METHOD_STORED)
+        return entry.size == entry.compressedSize ? std::optional(compressed) : std::nullopt;
+    if (entry.method != METHOD_DEFLATED)
+        return std::nullopt;
+
+    // Inflated straight from mapping into buffer, in chunks zlib can address
+    Trace::Scope scope("archive inflate", std::string(entry.name));
+    buffer.resize(entry.size);
+    z_stream stream{};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return std::nullopt;
+    uint64_t consumed = 0;
+    uint64_t produced = 0;
+    int result = Z_OK;
+    while (result == Z_OK)
+    {
+        if (stream.avail_in == 0)
+        {
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<std::byte*>(compressed.data() + consumed));
+            stream.avail_in = static_cast<uInt>(std::min<uint64_t>(compressed.size() - consumed, UINT_MAX));
+            consumed += stream.avail_in;
+        }
+        if (stream.avail_out == 0)
+        {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.data() + produced);
+            stream.avail_out = static_cast<uInt>(std::min<uint64_t>(buffer.size() - produced, UINT_MAX));
+            produced += stream.avail_out;
+        }
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_BUF_ERROR && stream.avail_in == 0 && consumed < compressed.size())
+            result = Z_OK;
+    }
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || stream.total_out != entry.size)
+        return std::nullopt;
+    return std::span<const std::byte>(buffer);
+}
+
+std::string ZipArchive::entryPath(const std::string& archive, std::string_view entry)
+{
+    return archive + "!/" + std::string(entry);
+}
+
+std::optional<std::pair<std::string, std::string>> ZipArchive::splitPath(std::string_view path)
+{
+    auto separator = path.find("!/");
+    if (separator == std::string_view::npos)
+        return std::nullopt;
+    return std::pair{std::string(path.substr(0, separator)), std::string(path.substr(separator + 2))};
+}
+
+bool ZipArchive::fail(std::string message)
+{
+    errorMessage = std::move(message);
+    entryList.clear();
+    file.close();
+    return false;
+}